@@ -13,12 +13,63 @@
 #include <iostream>
 #include <unordered_map>
 #include <functional>
+#include <algorithm>
+#include <utility>
+
+// Faults of a guest program. They never throw, emulateCycle() reports them as status code.
+enum class Trap {
+    None,
+    InvalidOpcode,
+    StackOverflow,
+    StackUnderflow,
+    MemoryOutOfRange
+};
+
+// Number of Trap enumerators including Trap::None, MemoryOutOfRange has to stay the last one
+constexpr size_t number_of_traps{static_cast<size_t>(Trap::MemoryOutOfRange) + 1};
+
+// Halt: the faulting instruction has no effect and the machine stops until clear_trap() is called.
+// Ignore: the faulting instruction has no effect and execution continues with the next one.
+// Callback: the trap handler decides between Halt and Ignore.
+enum class TrapPolicy {
+    Halt,
+    Ignore,
+    Callback
+};
+
+inline const char *to_string(Trap trap) {
+    switch (trap) {
+        case Trap::None:
+            return "none";
+        case Trap::InvalidOpcode:
+            return "invalid opcode";
+        case Trap::StackOverflow:
+            return "stack overflow";
+        case Trap::StackUnderflow:
+            return "stack underflow";
+        case Trap::MemoryOutOfRange:
+            return "memory out of range";
+    }
+    return "";
+}
+
+struct EmulationResult {
+    // Cycles which were executed, a cycle stopped by a halting trap is not counted
+    size_t cycles{};
+    // Cycles out of cycles which were fast-forwarded
+    size_t skipped_cycles{};
+    Trap trap{Trap::None};
+};
 
 
 template<size_t memory_in_bytes, size_t number_of_registers, size_t width_in_pixels, size_t height_in_pixels,
         size_t number_of_stack_levels, size_t number_of_keys>
 class Chip8 {
     friend class Chip8Test;
+    friend class Chip8Fuzzer;
+
+    template<typename Chip8Type>
+    friend class Chip8Debugger;
 
     using Bit16 = unsigned short;
     using Bit8 = unsigned char;
@@ -28,6 +79,7 @@ public:
         loadSpritesToMemory();
         initializeOpcodeMap();
         initializeTwoRegisterOperations();
+        initializeExternalActions();
     }
 
     void load_memory(const std::array<Bit8, memory_in_bytes - 512> &memory_to_load) {
@@ -36,6 +88,12 @@ public:
             memory[i + 512] = memory_to_load[i];
     }
 
+    void load_memory(const std::vector<Bit8> &program) {
+        // first 512 bytes are reserved for interpreter, programs which do not fit are truncated
+        const size_t size = std::min(program.size(), memory_in_bytes - 512);
+        std::copy(program.begin(), program.begin() + size, memory.begin() + 512);
+    }
+
     std::vector<Bit8> load_program(const std::string &filename) {
         std::ifstream file(filename, std::ios::binary | std::ios::ate);
         if (!file) {
@@ -69,16 +127,30 @@ public:
         loadSpritesToMemory();
         delayed_timer = 0;
         sound_timer = 0;
-
+        trap = Trap::None;
+        pending_trap = Trap::None;
     }
 
-    void emulateCycle() {
-        current_opcode = memory[program_counter] << 8 | memory[program_counter + 1];
-
-        register_index1 = (current_opcode & 0x0F00) >> 8;
-        register_index2 = (current_opcode & 0x00F0) >> 4;
-        auto choose = current_opcode & 0xF000;
-        opcodeMap[choose]();
+    // Returns the trap which halts the machine, Trap::None as long as it runs.
+    Trap emulateCycle() {
+        if (trap != Trap::None)
+            return trap;
+        if (static_cast<size_t>(program_counter + 1) < memory_in_bytes) {
+            decodeOpcode(fetchOpcode(program_counter));
+            auto choose = current_opcode & 0xF000;
+            opcodeMap[choose]();
+        } else {
+            raiseTrap(Trap::MemoryOutOfRange);
+        }
+        if (pending_trap != Trap::None) {
+            skip_instruction = false;
+            advance_program_counter = true;
+            const Trap raised = std::exchange(pending_trap, Trap::None);
+            if (resolveTrap(raised) == TrapPolicy::Halt) {
+                trap = raised;
+                return trap;
+            }
+        }
         if (delayed_timer > 0)
             --delayed_timer;
         if (sound_timer > 0) {
@@ -95,37 +167,217 @@ public:
         } else {
             advance_program_counter = true;
         }
+        return Trap::None;
+    }
+
+    // Runs number_of_cycles cycles or until a trap halts the machine. Delay timer polling loops (FX07; 3X00; 1NNN)
+    // and FX0A key waits are fast-forwarded instead of interpreted, the resulting state is identical to calling
+    // emulateCycle() that often.
+    EmulationResult emulateCycles(size_t number_of_cycles) {
+        EmulationResult result;
+        while (result.cycles < number_of_cycles) {
+            if (trap != Trap::None)
+                break;
+            const size_t skipped = skipIdleCycles(number_of_cycles - result.cycles);
+            if (skipped > 0) {
+                result.cycles += skipped;
+                result.skipped_cycles += skipped;
+                continue;
+            }
+            if (emulateCycle() != Trap::None)
+                break;
+            ++result.cycles;
+        }
+        result.trap = trap;
+        return result;
+    }
+
+    Trap get_trap() const {
+        return trap;
+    }
+
+    // Resumes a machine halted by a trap. The program counter still points to the faulting instruction.
+    void clear_trap() {
+        trap = Trap::None;
+    }
+
+    void set_trap_policy(Trap trap_to_configure, TrapPolicy policy) {
+        trap_policies[static_cast<size_t>(trap_to_configure)] = policy;
+    }
+
+    // Called for traps with TrapPolicy::Callback, returns TrapPolicy::Halt or TrapPolicy::Ignore.
+    void set_trap_handler(std::function<TrapPolicy(Trap)> handler) {
+        trap_handler = std::move(handler);
+    }
+
+    // A jump to itself is how programs stop, nothing changes anymore apart from the timers.
+    bool is_halted() const {
+        if (static_cast<size_t>(program_counter + 1) >= memory_in_bytes)
+            return false;
+        return fetchOpcode(program_counter) == (0x1000 | program_counter);
+    }
+
+    Bit16 get_program_counter() const {
+        return program_counter;
+    }
+
+    const std::array<Bit8, width_in_pixels * height_in_pixels> &get_graphics() const {
+        return graphics;
+    }
+
+    const std::array<Bit8, number_of_registers> &get_registers() const {
+        return registers;
+    }
+
+    Bit16 get_index_register() const {
+        return index_register;
+    }
+
+    Bit8 get_stack_pointer() const {
+        return stack_pointer;
+    }
+
+    Bit8 get_delay_timer() const {
+        return delayed_timer;
+    }
+
+    Bit8 get_sound_timer() const {
+        return sound_timer;
+    }
+
+    size_t get_number_of_keys() const {
+        return number_of_keys;
+    }
+
+    // Returns false and leaves the keypad unchanged for keys out of range.
+    bool set_key(size_t key, bool is_pressed) {
+        if (key >= number_of_keys)
+            return false;
+        keypad[key] = is_pressed ? 1 : 0;
+        return true;
+    }
+
+    // True if the next instruction is FX0A and no key is pressed, i.e. the machine does nothing until input arrives.
+    bool is_waiting_for_key() const {
+        if (trap != Trap::None || static_cast<size_t>(program_counter + 1) >= memory_in_bytes)
+            return false;
+        if ((fetchOpcode(program_counter) & 0xF0FF) != 0xF00A)
+            return false;
+        return std::all_of(keypad.begin(), keypad.end(), [](Bit8 key) { return key == 0; });
     }
 
 
 private:
+    Bit16 fetchOpcode(size_t address) const {
+        return memory[address] << 8 | memory[address + 1];
+    }
+
+    // Handlers check their accesses before they change any state and return right after raising a trap.
+    void raiseTrap(Trap raised) {
+        pending_trap = raised;
+    }
+
+    TrapPolicy resolveTrap(Trap raised) {
+        const TrapPolicy policy = trap_policies[static_cast<size_t>(raised)];
+        if (policy != TrapPolicy::Callback)
+            return policy;
+        return trap_handler && trap_handler(raised) == TrapPolicy::Ignore ? TrapPolicy::Ignore : TrapPolicy::Halt;
+    }
+
+    void decodeOpcode(Bit16 opcode) {
+        current_opcode = opcode;
+        register_index1 = (current_opcode & 0x0F00) >> 8;
+        register_index2 = (current_opcode & 0x00F0) >> 4;
+    }
+
+    // Timers are decremented once per cycle, this applies number_of_cycles decrements at once.
+    void advanceTimers(size_t number_of_cycles) {
+        delayed_timer = number_of_cycles < delayed_timer ? delayed_timer - number_of_cycles : 0;
+        if (sound_timer > 0) {
+            if (number_of_cycles >= sound_timer)
+                printf("BEEP!\n");
+            sound_timer = number_of_cycles < sound_timer ? sound_timer - number_of_cycles : 0;
+        }
+    }
+
+    // Returns the number of cycles (at most max_cycles) which could be skipped because the machine is idle.
+    size_t skipIdleCycles(size_t max_cycles) {
+        if (trap != Trap::None)
+            return 0;
+        if (is_waiting_for_key()) {
+            // Nothing but the timers changes until a key is pressed, and keys only change between calls.
+            decodeOpcode(fetchOpcode(program_counter));
+            advanceTimers(max_cycles);
+            return max_cycles;
+        }
+        return skipDelayTimerPollingLoop(max_cycles);
+    }
+
+    // Skips whole iterations of a "FX07; 3X00; 1NNN" loop (NNN being the address of FX07) which read a non-zero
+    // delay timer and therefore jump back. The iteration reading zero is left to emulateCycle().
+    size_t skipDelayTimerPollingLoop(size_t max_cycles) {
+        constexpr size_t cycles_per_iteration{3};
+        if (static_cast<size_t>(program_counter + 5) >= memory_in_bytes || delayed_timer == 0)
+            return 0;
+        const Bit16 read_timer = fetchOpcode(program_counter);
+        if ((read_timer & 0xF0FF) != 0xF007)
+            return 0;
+        const int x = (read_timer & 0x0F00) >> 8;
+        if (fetchOpcode(program_counter + 2) != (0x3000 | x << 8))
+            return 0;
+        const Bit16 jump = fetchOpcode(program_counter + 4);
+        if (jump != (0x1000 | program_counter))
+            return 0;
+
+        // Iteration k reads max(delayed_timer - 3k, 0), all iterations before the first zero read jump back.
+        const size_t polling_iterations = (delayed_timer + cycles_per_iteration - 1) / cycles_per_iteration;
+        const size_t iterations = std::min(polling_iterations, max_cycles / cycles_per_iteration);
+        if (iterations == 0)
+            return 0;
+        registers[x] = delayed_timer - cycles_per_iteration * (iterations - 1);
+        const size_t cycles = iterations * cycles_per_iteration;
+        advanceTimers(cycles);
+        decodeOpcode(jump);
+        return cycles;
+    }
+
     void twoRegisterOperations() {
         const int operation_index = (current_opcode & 0x000F);
-        if (twoRegisterOperationsMap.find(operation_index) == twoRegisterOperationsMap.end()) {
-            throw std::out_of_range("Invalid operation_index in twoRegisterOperations");
+        const auto operation = twoRegisterOperationsMap.find(operation_index);
+        if (operation == twoRegisterOperationsMap.end()) {
+            raiseTrap(Trap::InvalidOpcode);
+            return;
         }
-        twoRegisterOperationsMap[operation_index]();
+        operation->second();
     }
 
     void externalActions() {
         const int operation_index = current_opcode & 0x00FF;
-        if (externalActionOperations.find(operation_index) == externalActionOperations.end()) {
-            throw std::out_of_range("Invalid action in external actions");
+        const auto action = externalActionOperations.find(operation_index);
+        if (action == externalActionOperations.end()) {
+            raiseTrap(Trap::InvalidOpcode);
+            return;
         }
-        externalActionOperations[operation_index]();
+        action->second();
     }
 
     void skipInstructionKeyRegister() {
         const int decision = current_opcode & 0x00FF;
+        if (decision != 0x009E && decision != 0x00A1) {
+            raiseTrap(Trap::InvalidOpcode);
+            return;
+        }
+        if (registers[register_index1] >= number_of_keys) {
+            raiseTrap(Trap::MemoryOutOfRange);
+            return;
+        }
         // EX9E: Skips the next instruction if the key stored in register is pressed
         if (decision == 0x009E && keypad[registers[register_index1]] != 0) {
             skip_instruction = true;
         }
-            // EX9E: Skips the next instruction if the key stored in register is NOT pressed
+            // EXA1: Skips the next instruction if the key stored in register is NOT pressed
         else if (decision == 0x00A1 && keypad[registers[register_index1]] == 0) {
             skip_instruction = true;
-        } else {
-            throw std::out_of_range("Invalid decision in skipInstrcutionKeyRegister.");
         }
     }
 
@@ -138,7 +390,7 @@ private:
         externalActionOperations[0x000A] = [this]() {
             bool isKeyPressed{false};
 
-            for (int key{}; key < number_of_keys; ++key) {
+            for (size_t key{}; key < number_of_keys; ++key) {
                 if (keypad[key] != 0) {
                     registers[register_index1] = key;
                     isKeyPressed = true;
@@ -147,7 +399,7 @@ private:
 
             // If we didn't received a keypress, skip this cycle and try again.
             if (!isKeyPressed)
-                return;
+                advance_program_counter = false;
         };
         // FX15: Sets the delay timer to to register with index given at X
         externalActionOperations[0x0015] = [this]() {
@@ -175,12 +427,20 @@ private:
         };
         // FX33: Stores the Binary-coded decimal representation of register X at the addresses index_register, index_register+1, and index_register+2
         externalActionOperations[0x0033] = [this]() {
+            if (static_cast<size_t>(index_register + 2) >= memory_in_bytes) {
+                raiseTrap(Trap::MemoryOutOfRange);
+                return;
+            }
             memory[index_register + 2] = registers[register_index1] % 10; // last digit
             memory[index_register + 1] = (registers[register_index1] / 10) % 10;
             memory[index_register] = registers[register_index1] / 100; // first digit
         };
         // FX55: Stores value in register 0 to  register X in memory starting at address index_register
         externalActionOperations[0x055] = [this]() {
+            if (static_cast<size_t>(index_register + register_index1) >= memory_in_bytes) {
+                raiseTrap(Trap::MemoryOutOfRange);
+                return;
+            }
             for (int i{}; i <= register_index1; ++i)
                 memory[index_register + i] = registers[i];
             // On the original interpreter, when the operation is done, register_index = register_index + X + 1.
@@ -189,6 +449,10 @@ private:
         };
         // FX65: Fills register 0 to register X with values from memory starting at address I
         externalActionOperations[0x065] = [this]() {
+            if (static_cast<size_t>(index_register + register_index1) >= memory_in_bytes) {
+                raiseTrap(Trap::MemoryOutOfRange);
+                return;
+            }
             for (int i{}; i <= register_index1; ++i)
                 registers[i] = memory[index_register + i];
             // On the original interpreter, when the operation is done, register_index = register_index + X + 1.
@@ -262,11 +526,15 @@ private:
                 std::fill(graphics.begin(), graphics.end(), 0);
                 draw_flag = true;
             } else if ((current_opcode & 0x000F) == 0x000E) {
+                if (stack_pointer == 0) {
+                    raiseTrap(Trap::StackUnderflow);
+                    return;
+                }
                 --stack_pointer;
                 program_counter = stack[stack_pointer];
 
             } else {
-                throw std::out_of_range("Unknown opcode for: (opcode & 0x000F) == 0");
+                raiseTrap(Trap::InvalidOpcode);
             }
         };
         // jump to address
@@ -276,6 +544,10 @@ private:
         };
         // 0x2NNN: Calls subroutine at NNN.
         opcodeMap[0x2000] = [this]() {
+            if (stack_pointer >= number_of_stack_levels) {
+                raiseTrap(Trap::StackOverflow);
+                return;
+            }
             stack[stack_pointer] = program_counter;
             ++stack_pointer;
             program_counter = current_opcode & 0x0FFF;
@@ -345,6 +617,21 @@ private:
         auto x = registers[register_index1];
         auto y = registers[register_index2];
         unsigned short height = current_opcode & 0x000F;
+        if (index_register + height > memory_in_bytes) {
+            raiseTrap(Trap::MemoryOutOfRange);
+            return;
+        }
+        // Sprites are not clipped, every pixel which would be flipped has to be on the screen
+        for (int y_line{}; y_line < height; ++y_line) {
+            unsigned short pixel = memory[index_register + y_line];
+            for (int x_line{}; x_line < height; ++x_line) {
+                if ((pixel & (0x80 >> x_line)) != 0 &&
+                    static_cast<size_t>(x + x_line + ((y + y_line) * 64)) >= graphics.size()) {
+                    raiseTrap(Trap::MemoryOutOfRange);
+                    return;
+                }
+            }
+        }
         registers[number_of_registers - 1] = 0;
         for (int y_line{}; y_line < height; ++y_line) {
             unsigned short pixel = memory[index_register + y_line];
@@ -391,6 +678,8 @@ private:
     std::unordered_map<int, std::function<void()>> opcodeMap;
     std::unordered_map<int, std::function<void()>> twoRegisterOperationsMap;
     std::unordered_map<int, std::function<void()>> externalActionOperations;
+    std::array<TrapPolicy, number_of_traps> trap_policies{};
+    std::function<TrapPolicy(Trap)> trap_handler;
     Bit16 current_opcode{};
     Bit16 index_register{};
     Bit16 program_counter = 0x200;
@@ -400,6 +689,8 @@ private:
     bool advance_program_counter{true};
     bool skip_instruction{false};
     bool draw_flag{false};
+    Trap trap{Trap::None};
+    Trap pending_trap{Trap::None};
     int register_index1;
     int register_index2;
 
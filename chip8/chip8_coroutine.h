@@ -0,0 +1,240 @@
+//
+// Created by andreas on 18.10.26.
+//
+
+#ifndef CHIP8_COROUTINE_H
+#define CHIP8_COROUTINE_H
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+#include <vector>
+#include "chip8.h"
+
+// Coroutine driven by a Chip8Scheduler. It starts running right away and is suspended at every co_await of
+// Chip8CoroutineMachine::run_until_frame(), the Chip8Task owns the coroutine frame. Destroying the task while it is
+// suspended removes it from the scheduler.
+class Chip8Task {
+public:
+    struct promise_type {
+        Chip8Task get_return_object() {
+            return Chip8Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_never initial_suspend() noexcept { return {}; }
+
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+
+        // The engine reports faults as traps, nothing is expected to escape a coroutine
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+    Chip8Task(Chip8Task &&other) noexcept: handle(std::exchange(other.handle, {})) {}
+
+    Chip8Task &operator=(Chip8Task &&other) noexcept {
+        if (this != &other) {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+
+    Chip8Task(const Chip8Task &) = delete;
+
+    Chip8Task &operator=(const Chip8Task &) = delete;
+
+    ~Chip8Task() {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool done() const {
+        return !handle || handle.done();
+    }
+
+private:
+    explicit Chip8Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Single threaded frame scheduler. The host event loop calls run_frame() once per frame (e.g. every 1/60 s),
+// which resumes every coroutine that asked to run in this frame. Nothing blocks, coroutines waiting for a key
+// are not scheduled until the key arrives.
+class Chip8Scheduler {
+public:
+    void schedule(std::coroutine_handle<> handle) {
+        next_frame.push_back(handle);
+    }
+
+    // Removes a coroutine which is not resumed yet, e.g. because its frame is about to be destroyed.
+    // Can be called from a coroutine which is resumed by run_frame().
+    void cancel(std::coroutine_handle<> handle) {
+        next_frame.erase(std::remove(next_frame.begin(), next_frame.end(), handle), next_frame.end());
+        if (is_running)
+            std::replace(current_frame.begin(), current_frame.end(), handle, std::coroutine_handle<>());
+    }
+
+    // Returns the number of coroutines which were resumed.
+    size_t run_frame() {
+        std::swap(current_frame, next_frame);
+        is_running = true;
+        size_t resumed{};
+        for (size_t i{}; i < current_frame.size(); ++i) {
+            if (!current_frame[i])
+                continue;
+            current_frame[i].resume();
+            ++resumed;
+        }
+        is_running = false;
+        current_frame.clear();
+        ++frame;
+        return resumed;
+    }
+
+    // Index of the frame in which a coroutine scheduled now will be resumed
+    size_t next_frame_index() const {
+        return is_running ? frame + 1 : frame;
+    }
+
+    size_t scheduled() const {
+        return next_frame.size();
+    }
+
+private:
+    std::vector<std::coroutine_handle<>> current_frame;
+    std::vector<std::coroutine_handle<>> next_frame;
+    size_t frame{};
+    bool is_running{false};
+};
+
+enum class FrameResult {
+    Frame,
+    KeyWait,
+    Trap
+};
+
+// Runs a Chip8 instance frame by frame from a coroutine:
+//     while (true) co_await machine.run_until_frame();
+// Each co_await suspends until the scheduler's next frame and then emulates one frame. A machine which ended its
+// frame in an FX0A key wait is parked instead of scheduled. set_key() fast-forwards it through the frames it missed
+// and schedules it again, so the result is identical to running every frame. Timers tick once per cycle in this
+// engine, so frame boundaries are the only points where they have to be observed.
+// The coroutine waiting in run_until_frame() is cancelled when its task or the machine is destroyed, or by cancel().
+template<typename Chip8Type>
+class Chip8CoroutineMachine {
+public:
+    class FrameAwaiter {
+    public:
+        explicit FrameAwaiter(Chip8CoroutineMachine &machine) : machine(&machine) {}
+
+        FrameAwaiter(const FrameAwaiter &) = delete;
+
+        FrameAwaiter &operator=(const FrameAwaiter &) = delete;
+
+        // Lives in the coroutine frame, destroying a suspended coroutine destroys it before it was resumed
+        ~FrameAwaiter() {
+            if (machine != nullptr && machine->waiting == this)
+                machine->cancel();
+        }
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            suspended = handle;
+            machine->waiting = this;
+            if (machine->chip.is_waiting_for_key()) {
+                machine->parked = handle;
+                machine->parked_frame = machine->scheduler.next_frame_index();
+            } else {
+                machine->scheduler.schedule(handle);
+            }
+        }
+
+        FrameResult await_resume() {
+            machine->waiting = nullptr;
+            if (machine->chip.emulateCycles(machine->cycles_per_frame).trap != Trap::None)
+                return FrameResult::Trap;
+            return machine->chip.is_waiting_for_key() ? FrameResult::KeyWait : FrameResult::Frame;
+        }
+
+    private:
+        friend class Chip8CoroutineMachine;
+
+        // nullptr once the machine cancelled the suspended coroutine
+        Chip8CoroutineMachine *machine;
+        std::coroutine_handle<> suspended;
+    };
+
+    Chip8CoroutineMachine(Chip8Type &chip, Chip8Scheduler &scheduler, size_t cycles_per_frame = 10)
+            : chip(chip), scheduler(scheduler), cycles_per_frame(cycles_per_frame) {}
+
+    Chip8CoroutineMachine(const Chip8CoroutineMachine &) = delete;
+
+    Chip8CoroutineMachine &operator=(const Chip8CoroutineMachine &) = delete;
+
+    ~Chip8CoroutineMachine() {
+        cancel();
+    }
+
+    // Removes the machine from the scheduler. The coroutine waiting in run_until_frame() stays suspended and is
+    // never resumed, its task can still be destroyed.
+    void cancel() {
+        if (waiting == nullptr)
+            return;
+        if (parked)
+            parked = {};
+        else
+            scheduler.cancel(waiting->suspended);
+        waiting->machine = nullptr;
+        waiting = nullptr;
+    }
+
+    bool is_waiting() const {
+        return waiting != nullptr;
+    }
+
+    FrameAwaiter run_until_frame() {
+        return FrameAwaiter(*this);
+    }
+
+    // Returns false and does nothing for keys out of range.
+    bool set_key(size_t key, bool is_pressed) {
+        if (key >= chip.get_number_of_keys())
+            return false;
+        if (parked) {
+            const size_t missed_frames = scheduler.next_frame_index() - parked_frame;
+            chip.emulateCycles(missed_frames * cycles_per_frame);
+        }
+        chip.set_key(key, is_pressed);
+        if (parked && !chip.is_waiting_for_key())
+            scheduler.schedule(std::exchange(parked, {}));
+        else if (parked)
+            parked_frame = scheduler.next_frame_index();
+        return true;
+    }
+
+    bool is_parked() const {
+        return static_cast<bool>(parked);
+    }
+
+private:
+    Chip8Type &chip;
+    Chip8Scheduler &scheduler;
+    size_t cycles_per_frame;
+    std::coroutine_handle<> parked;
+    size_t parked_frame{};
+    // Awaiter of the suspended coroutine which is parked or scheduled, nullptr while none is
+    FrameAwaiter *waiting{nullptr};
+};
+
+#endif //CHIP8_COROUTINE_H
@@ -0,0 +1,272 @@
+//
+// Created by andreas on 18.10.26.
+//
+
+#ifndef CHIP8_DEBUGGER_H
+#define CHIP8_DEBUGGER_H
+
+#include <cstddef>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include "chip8.h"
+
+enum class DebugStopReason {
+    CycleLimit,
+    Breakpoint,
+    MemoryRead,
+    MemoryWrite,
+    RegisterChange,
+    Step,
+    Trap
+};
+
+struct DebugEvent {
+    DebugStopReason reason{DebugStopReason::CycleLimit};
+    // Number of cycles executed by the call which returned this event
+    size_t cycles{};
+    // Program counter for breakpoints, first watched address accessed for memory watchpoints
+    size_t address{};
+    int register_index{-1};
+    // Trap which halted the chip for DebugStopReason::Trap
+    Trap trap{Trap::None};
+};
+
+// Drives a Chip8 instance with PC breakpoints, memory watchpoints and register conditions.
+// Breakpoints are checked by the run loop before an instruction is executed. Memory watchpoints and register
+// conditions need to see every instruction, for these the opcodeMap of the chip is swapped with an instrumented copy
+// while at least one of them is set. Without any of them run() forwards to emulateCycles(), so the chip runs through
+// its plain opcodeMap exactly as without a debugger.
+template<typename Chip8Type>
+class Chip8Debugger {
+    using Bit8 = typename Chip8Type::Bit8;
+    using Bit16 = typename Chip8Type::Bit16;
+    using OpcodeMap = std::unordered_map<int, std::function<void()>>;
+    using RegisterCondition = std::function<bool(Bit8 old_value, Bit8 new_value)>;
+
+    struct MemoryWatchpoint {
+        size_t begin;
+        size_t end;
+        bool on_read;
+        bool on_write;
+    };
+
+    struct RegisterWatchpoint {
+        int register_index;
+        RegisterCondition condition;
+    };
+
+public:
+    explicit Chip8Debugger(Chip8Type &chip) : chip(chip) {}
+
+    ~Chip8Debugger() {
+        uninstrument();
+    }
+
+    Chip8Debugger(const Chip8Debugger &) = delete;
+
+    Chip8Debugger &operator=(const Chip8Debugger &) = delete;
+
+    void add_breakpoint(Bit16 address) {
+        breakpoints.insert(address);
+    }
+
+    void remove_breakpoint(Bit16 address) {
+        breakpoints.erase(address);
+    }
+
+    // Stops after an instruction which reads and/or writes memory in [begin, end).
+    // Instruction fetches are not reported, use breakpoints for these.
+    void add_memory_watchpoint(size_t begin, size_t end, bool on_read, bool on_write) {
+        memory_watchpoints.push_back({begin, end, on_read, on_write});
+        instrument();
+    }
+
+    // Stops after an instruction for which condition(old_value, new_value) of the register holds,
+    // by default whenever the value changes. Returns false and adds nothing for registers out of range.
+    bool add_register_watchpoint(int register_index, RegisterCondition condition = [](Bit8 old_value, Bit8 new_value) {
+        return old_value != new_value;
+    }) {
+        if (register_index < 0 || static_cast<size_t>(register_index) >= chip.registers.size())
+            return false;
+        register_watchpoints.push_back({register_index, std::move(condition)});
+        instrument();
+        return true;
+    }
+
+    void clear() {
+        breakpoints.clear();
+        memory_watchpoints.clear();
+        register_watchpoints.clear();
+        uninstrument();
+    }
+
+    bool is_instrumented() const {
+        return instrumented;
+    }
+
+    // Runs at most max_cycles cycles. Breakpoints are checked before every instruction, the breakpoint which stopped
+    // the previous call is stepped over, so run() resumes after a hit.
+    DebugEvent run(size_t max_cycles) {
+        DebugEvent event;
+        if (!instrumented && breakpoints.empty()) {
+            const auto result = chip.emulateCycles(max_cycles);
+            event.cycles = result.cycles;
+            if (result.trap != Trap::None) {
+                event.reason = DebugStopReason::Trap;
+                event.trap = result.trap;
+            }
+            return event;
+        }
+        while (event.cycles < max_cycles) {
+            if (stopAtBreakpoint(event))
+                return event;
+            if (cycle(event))
+                return event;
+        }
+        return event;
+    }
+
+    DebugEvent step() {
+        DebugEvent event;
+        if (!cycle(event))
+            event.reason = DebugStopReason::Step;
+        return event;
+    }
+
+    // Like step(), but a 2NNN call is run until it returned to the next instruction on the same stack level.
+    // Stops earlier if a breakpoint or watchpoint is hit or max_cycles are executed.
+    DebugEvent step_over(size_t max_cycles) {
+        const Bit16 opcode = chip.fetchOpcode(chip.program_counter);
+        if ((opcode & 0xF000) != 0x2000)
+            return step();
+
+        const Bit16 return_address = chip.program_counter + 2;
+        const auto stack_level = chip.stack_pointer;
+        DebugEvent event;
+        while (event.cycles < max_cycles) {
+            if (stopAtBreakpoint(event))
+                return event;
+            if (cycle(event))
+                return event;
+            if (chip.program_counter == return_address && chip.stack_pointer == stack_level) {
+                event.reason = DebugStopReason::Step;
+                return event;
+            }
+        }
+        return event;
+    }
+
+private:
+    bool stopAtBreakpoint(DebugEvent &event) {
+        if (is_resuming_from_breakpoint || breakpoints.count(chip.program_counter) == 0)
+            return false;
+        event.reason = DebugStopReason::Breakpoint;
+        event.address = chip.program_counter;
+        is_resuming_from_breakpoint = true;
+        return true;
+    }
+
+    // Executes one cycle, returns true if a watchpoint was hit or a trap halted the chip.
+    bool cycle(DebugEvent &event) {
+        is_resuming_from_breakpoint = false;
+        pending_event.reason = DebugStopReason::CycleLimit;
+        const Trap trap = chip.emulateCycle();
+        if (trap != Trap::None) {
+            event.reason = DebugStopReason::Trap;
+            event.trap = trap;
+            return true;
+        }
+        ++event.cycles;
+        if (pending_event.reason == DebugStopReason::CycleLimit)
+            return false;
+        event.reason = pending_event.reason;
+        event.address = pending_event.address;
+        event.register_index = pending_event.register_index;
+        return true;
+    }
+
+    void instrument() {
+        if (instrumented)
+            return;
+        OpcodeMap instrumented_map;
+        for (const auto &entry: chip.opcodeMap) {
+            auto handler = entry.second;
+            instrumented_map[entry.first] = [this, handler]() {
+                checkMemoryWatchpoints();
+                const auto registers = chip.registers;
+                handler();
+                checkRegisterWatchpoints(registers);
+            };
+        }
+        plain_opcode_map = std::move(chip.opcodeMap);
+        chip.opcodeMap = std::move(instrumented_map);
+        instrumented = true;
+    }
+
+    void uninstrument() {
+        if (!instrumented)
+            return;
+        chip.opcodeMap = std::move(plain_opcode_map);
+        plain_opcode_map.clear();
+        instrumented = false;
+    }
+
+    // Memory range [begin, end) accessed by the current instruction, based on the decoded opcode
+    void checkMemoryWatchpoints() {
+        const Bit16 opcode = chip.current_opcode;
+        const size_t begin = chip.index_register;
+        size_t end{begin};
+        bool is_write{false};
+        if ((opcode & 0xF000) == 0xD000) {
+            end = begin + (opcode & 0x000F);
+        } else if ((opcode & 0xF0FF) == 0xF033) {
+            end = begin + 3;
+            is_write = true;
+        } else if ((opcode & 0xF0FF) == 0xF055) {
+            end = begin + chip.register_index1 + 1;
+            is_write = true;
+        } else if ((opcode & 0xF0FF) == 0xF065) {
+            end = begin + chip.register_index1 + 1;
+        }
+        if (begin == end)
+            return;
+
+        for (const auto &watchpoint: memory_watchpoints) {
+            if ((is_write ? !watchpoint.on_write : !watchpoint.on_read) || end <= watchpoint.begin ||
+                watchpoint.end <= begin)
+                continue;
+            pending_event.reason = is_write ? DebugStopReason::MemoryWrite : DebugStopReason::MemoryRead;
+            pending_event.address = std::max(begin, watchpoint.begin);
+            return;
+        }
+    }
+
+    template<typename Registers>
+    void checkRegisterWatchpoints(const Registers &old_registers) {
+        if (pending_event.reason != DebugStopReason::CycleLimit)
+            return;
+        for (const auto &watchpoint: register_watchpoints) {
+            const auto index = watchpoint.register_index;
+            if (!watchpoint.condition(old_registers[index], chip.registers[index]))
+                continue;
+            pending_event.reason = DebugStopReason::RegisterChange;
+            pending_event.register_index = index;
+            return;
+        }
+    }
+
+    Chip8Type &chip;
+    OpcodeMap plain_opcode_map;
+    std::unordered_set<size_t> breakpoints;
+    std::vector<MemoryWatchpoint> memory_watchpoints;
+    std::vector<RegisterWatchpoint> register_watchpoints;
+    DebugEvent pending_event;
+    bool instrumented{false};
+    // Set when the last call stopped at a breakpoint, the next cycle starts there and must not stop again
+    bool is_resuming_from_breakpoint{false};
+};
+
+#endif //CHIP8_DEBUGGER_H
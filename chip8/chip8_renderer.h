@@ -0,0 +1,168 @@
+//
+// Created by andreas on 18.10.26.
+//
+
+#ifndef CHIP8_RENDERER_H
+#define CHIP8_RENDERER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Single producer, single consumer triple buffer. The producer fills back(), publish() swaps it with the middle
+// buffer. The consumer swaps the middle buffer into front() if a newer one was published. Neither side ever waits,
+// if the consumer is slow the producer overwrites the middle buffer and that frame is dropped.
+template<typename T>
+class TripleBuffer {
+    // middle holds the index of the middle buffer in the lower bits, fresh_bit is set while it is published and not
+    // consumed yet, closed_bit once the producer is done
+    static constexpr uint8_t fresh_bit{0x4};
+    static constexpr uint8_t closed_bit{0x8};
+    static constexpr uint8_t index_mask{0x3};
+
+public:
+    T &back() {
+        return buffers[back_index];
+    }
+
+    const T &front() const {
+        return buffers[front_index];
+    }
+
+    void publish() {
+        const uint8_t previous = middle.exchange(back_index | fresh_bit, std::memory_order_acq_rel);
+        back_index = previous & index_mask;
+        middle.notify_one();
+    }
+
+    // Returns true if front() changed.
+    bool consume() {
+        if ((middle.load(std::memory_order_relaxed) & fresh_bit) == 0)
+            return false;
+        const uint8_t previous = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = previous & index_mask;
+        return true;
+    }
+
+    // Blocks the consumer until a buffer is published or close() is called.
+    void wait() const {
+        middle.wait(middle.load(std::memory_order_relaxed) & index_mask, std::memory_order_acquire);
+    }
+
+    // Wakes a waiting consumer for good, wait() returns immediately afterwards.
+    void close() {
+        middle.fetch_or(closed_bit, std::memory_order_release);
+        middle.notify_one();
+    }
+
+private:
+    std::array<T, 3> buffers{};
+    std::atomic<uint8_t> middle{1};
+    uint8_t back_index{0};
+    uint8_t front_index{2};
+};
+
+// Draws a framebuffer to a terminal on its own thread. Two pixel rows form one cell of Unicode half blocks, only
+// cells which changed since the last drawn frame are written, addressed with ANSI cursor movements.
+// publish() is called by the emulation at frame boundaries and never waits for the terminal.
+template<size_t width_in_pixels, size_t height_in_pixels>
+class TerminalRenderer {
+public:
+    using Framebuffer = std::array<unsigned char, width_in_pixels * height_in_pixels>;
+    static constexpr size_t number_of_rows{(height_in_pixels + 1) / 2};
+
+    explicit TerminalRenderer(std::ostream &out) : out(out), thread([this]() { render(); }) {}
+
+    TerminalRenderer(const TerminalRenderer &) = delete;
+
+    TerminalRenderer &operator=(const TerminalRenderer &) = delete;
+
+    ~TerminalRenderer() {
+        stop();
+    }
+
+    // Draws the last published frame and joins the render thread.
+    void stop() {
+        if (!thread.joinable())
+            return;
+        is_running.store(false, std::memory_order_release);
+        frames.close();
+        thread.join();
+    }
+
+    void publish(const Framebuffer &graphics) {
+        frames.back() = graphics;
+        frames.publish();
+        published.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t published_frames() const {
+        return published.load(std::memory_order_relaxed);
+    }
+
+    size_t drawn_frames() const {
+        return drawn.load(std::memory_order_relaxed);
+    }
+
+    // Appends the escape sequences which turn the cells of previous into the cells of graphics to output.
+    // Returns the number of changed cells.
+    static size_t draw_changes(const Framebuffer &graphics, std::array<uint8_t, width_in_pixels * number_of_rows> &previous,
+                               std::string &output) {
+        static const char *const blocks[]{" ", "▀", "▄", "█"};
+        size_t changed{};
+        for (size_t row{}; row < number_of_rows; ++row) {
+            bool is_cursor_in_place{false};
+            for (size_t column{}; column < width_in_pixels; ++column) {
+                const size_t top = column + 2 * row * width_in_pixels;
+                const size_t bottom = top + width_in_pixels;
+                const uint8_t cell = (graphics[top] != 0 ? 0x1 : 0) |
+                                     (bottom < graphics.size() && graphics[bottom] != 0 ? 0x2 : 0);
+                if (cell == previous[column + row * width_in_pixels]) {
+                    is_cursor_in_place = false;
+                    continue;
+                }
+                previous[column + row * width_in_pixels] = cell;
+                if (!is_cursor_in_place)
+                    output += "\x1b[" + std::to_string(row + 1) + ';' + std::to_string(column + 1) + 'H';
+                output += blocks[cell];
+                is_cursor_in_place = true;
+                ++changed;
+            }
+        }
+        return changed;
+    }
+
+private:
+    void render() {
+        std::array<uint8_t, width_in_pixels * number_of_rows> cells{};
+        std::string output{"\x1b[2J"};
+        while (true) {
+            if (!frames.consume()) {
+                if (!is_running.load(std::memory_order_acquire))
+                    break;
+                frames.wait();
+                continue;
+            }
+            draw_changes(frames.front(), cells, output);
+            if (!output.empty()) {
+                out << output << std::flush;
+                output.clear();
+            }
+            drawn.fetch_add(1, std::memory_order_relaxed);
+        }
+        out << "\x1b[" << number_of_rows + 1 << ";1H" << std::flush;
+    }
+
+    std::ostream &out;
+    TripleBuffer<Framebuffer> frames;
+    std::atomic<bool> is_running{true};
+    std::atomic<size_t> published{0};
+    std::atomic<size_t> drawn{0};
+    std::thread thread;
+};
+
+#endif //CHIP8_RENDERER_H
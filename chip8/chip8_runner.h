@@ -0,0 +1,198 @@
+//
+// Created by andreas on 18.10.26.
+//
+
+#ifndef CHIP8_RUNNER_H
+#define CHIP8_RUNNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include "chip8_debugger.h"
+
+enum class RunStop {
+    CycleLimit,
+    FrameLimit,
+    ProgramCounter,
+    Halt,
+    Trap
+};
+
+struct RunOptions {
+    size_t max_cycles{std::numeric_limits<size_t>::max()};
+    size_t max_frames{std::numeric_limits<size_t>::max()};
+    // Timers tick once per cycle, a frame is a fixed number of cycles
+    size_t cycles_per_frame{10};
+    bool stop_at_program_counter{false};
+    unsigned short stop_program_counter{};
+    bool stop_on_halt{true};
+    // Called after every complete frame, e.g. to publish the framebuffer to a renderer
+    std::function<void()> on_frame;
+};
+
+// Key state change applied at the beginning of frame
+struct KeyEvent {
+    size_t frame;
+    size_t key;
+    bool is_pressed;
+};
+
+struct RunResult {
+    RunStop stop{RunStop::CycleLimit};
+    size_t cycles{};
+    size_t frames{};
+    size_t skipped_cycles{};
+    double seconds{};
+    Trap trap{Trap::None};
+};
+
+// FNV-1a, used to compare framebuffers and registers against golden results
+template<typename Container>
+uint64_t fnv1a_hash(const Container &bytes, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (auto byte: bytes) {
+        hash ^= static_cast<uint8_t>(byte);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Reads lines of "frame key pressed", e.g. "120 5 1" presses key 5 at frame 120. Events have to be sorted by frame.
+// Returns false if the file can't be read, isn't made of such lines, has keys out of range or isn't sorted.
+inline bool load_key_trace(const std::string &filename, std::vector<KeyEvent> &events, size_t number_of_keys = 16) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+    size_t frame{};
+    size_t key{};
+    int is_pressed{};
+    while (file >> frame >> key >> is_pressed) {
+        if (key >= number_of_keys) {
+            std::cerr << "Malformed key event in " << filename << " after " << events.size() << " events, key "
+                      << key << " out of range" << std::endl;
+            return false;
+        }
+        if (!events.empty() && frame < events.back().frame) {
+            std::cerr << "Key events not sorted by frame in " << filename << " at frame " << frame << std::endl;
+            return false;
+        }
+        events.push_back({frame, key, is_pressed != 0});
+    }
+    if (!file.eof()) {
+        std::cerr << "Malformed key event in " << filename << " after " << events.size() << " events" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Writes the framebuffer as plain PBM, set pixels are black.
+template<typename Chip8Type>
+bool write_pbm(const Chip8Type &chip, size_t width_in_pixels, size_t height_in_pixels, const std::string &filename) {
+    std::ofstream file(filename);
+    if (!file)
+        return false;
+    const auto &graphics = chip.get_graphics();
+    file << "P1\n" << width_in_pixels << ' ' << height_in_pixels << '\n';
+    for (size_t y{}; y < height_in_pixels; ++y) {
+        for (size_t x{}; x < width_in_pixels; ++x)
+            file << (graphics[x + y * width_in_pixels] != 0 ? '1' : '0') << (x + 1 < width_in_pixels ? ' ' : '\n');
+    }
+    return static_cast<bool>(file);
+}
+
+// Runs frames until one of the limits in options is reached. Idle loops are fast-forwarded by emulateCycles(),
+// a program counter condition runs through a Chip8Debugger breakpoint instead. Without on_frame the frames spent
+// in a key wait are run by a single emulateCycles() call.
+template<typename Chip8Type>
+RunResult run_frames(Chip8Type &chip, const RunOptions &options, const std::vector<KeyEvent> &key_trace = {}) {
+    RunResult result;
+    Chip8Debugger<Chip8Type> debugger(chip);
+    if (options.stop_at_program_counter)
+        debugger.add_breakpoint(options.stop_program_counter);
+    auto next_key_event = key_trace.begin();
+    const auto start = std::chrono::steady_clock::now();
+
+    while (true) {
+        if (result.frames >= options.max_frames) {
+            result.stop = RunStop::FrameLimit;
+            break;
+        }
+        if (result.cycles >= options.max_cycles) {
+            result.stop = RunStop::CycleLimit;
+            break;
+        }
+        if (options.stop_on_halt && chip.is_halted()) {
+            result.stop = RunStop::Halt;
+            break;
+        }
+        for (; next_key_event != key_trace.end() && next_key_event->frame <= result.frames; ++next_key_event)
+            chip.set_key(next_key_event->key, next_key_event->is_pressed);
+
+        // Nothing but the timers changes until the next key event, run all frames up to it at once
+        const bool is_at_stop_program_counter =
+                options.stop_at_program_counter && chip.get_program_counter() == options.stop_program_counter;
+        if (!options.on_frame && !is_at_stop_program_counter && chip.is_waiting_for_key()) {
+            size_t idle_frames = std::min(options.max_frames - result.frames,
+                                          (options.max_cycles - result.cycles) / options.cycles_per_frame);
+            if (next_key_event != key_trace.end())
+                idle_frames = std::min(idle_frames, next_key_event->frame - result.frames);
+            if (idle_frames > 0) {
+                const auto emulation = chip.emulateCycles(idle_frames * options.cycles_per_frame);
+                result.skipped_cycles += emulation.skipped_cycles;
+                result.cycles += emulation.cycles;
+                result.frames += idle_frames;
+                continue;
+            }
+        }
+
+        const size_t cycles = std::min(options.cycles_per_frame, options.max_cycles - result.cycles);
+        if (options.stop_at_program_counter) {
+            const auto event = debugger.run(cycles);
+            result.cycles += event.cycles;
+            if (event.reason == DebugStopReason::Breakpoint) {
+                result.stop = RunStop::ProgramCounter;
+                break;
+            }
+        } else {
+            const auto emulation = chip.emulateCycles(cycles);
+            result.skipped_cycles += emulation.skipped_cycles;
+            result.cycles += emulation.cycles;
+        }
+        if (chip.get_trap() != Trap::None) {
+            result.stop = RunStop::Trap;
+            result.trap = chip.get_trap();
+            break;
+        }
+        ++result.frames;
+        if (options.on_frame)
+            options.on_frame();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+inline std::string to_string(RunStop stop) {
+    switch (stop) {
+        case RunStop::CycleLimit:
+            return "cycle limit";
+        case RunStop::FrameLimit:
+            return "frame limit";
+        case RunStop::ProgramCounter:
+            return "program counter";
+        case RunStop::Halt:
+            return "halt";
+        case RunStop::Trap:
+            return "trap";
+    }
+    return {};
+}
+
+#endif //CHIP8_RUNNER_H
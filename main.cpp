@@ -2,8 +2,42 @@
 // Created by andreas on 09.02.24.
 //
 
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include "chip8/chip8.h"
-int main()
+#include "chip8/chip8_runner.h"
+#include "chip8/chip8_renderer.h"
+
+void print_usage(const char *program_name) {
+	std::cerr << "Usage: " << program_name << " ROM [options]\n"
+	          << "  --cycles N            stop after N cycles\n"
+	          << "  --frames N            stop after N frames (default 600 if no other limit is given)\n"
+	          << "  --cycles-per-frame N  cycles per frame (default 10)\n"
+	          << "  --until-pc ADDRESS    stop before executing ADDRESS (hex)\n"
+	          << "  --no-halt             keep running when the program jumps to itself\n"
+	          << "  --keys FILE           key trace, lines of \"frame key pressed\"\n"
+	          << "  --pbm FILE            write the final screen as PBM\n"
+	          << "  --render              draw the screen to the terminal (stderr) while running\n";
+}
+
+// Parses the whole of text as a number, false for empty, partial, signed or out of range input.
+bool parse_number(const char *text, size_t &value, int base = 10) {
+	if (!std::isxdigit(static_cast<unsigned char>(*text)))
+		return false;
+	char *end{};
+	errno = 0;
+	const unsigned long long number = std::strtoull(text, &end, base);
+	if (*end != '\0' || errno == ERANGE || number > std::numeric_limits<size_t>::max())
+		return false;
+	value = number;
+	return true;
+}
+
+int main(int argc, char **argv)
 {
 	constexpr size_t memory_in_bytes{4096};
 	constexpr size_t number_of_registers{16};
@@ -13,4 +47,86 @@ int main()
 	constexpr size_t number_of_keys{16};
 	auto chip = Chip8<memory_in_bytes, number_of_registers, width_in_pixels, height_in_pixels, number_of_stack_levels, number_of_keys>();
 
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	RunOptions options;
+	std::vector<KeyEvent> key_trace;
+	std::string pbm_filename;
+	bool has_limit{false};
+	bool render{false};
+	for (int i{2}; i < argc; ++i) {
+		const bool has_value = i + 1 < argc;
+		bool is_valid{true};
+		if (std::strcmp(argv[i], "--cycles") == 0 && has_value) {
+			is_valid = parse_number(argv[++i], options.max_cycles);
+			has_limit = true;
+		} else if (std::strcmp(argv[i], "--frames") == 0 && has_value) {
+			is_valid = parse_number(argv[++i], options.max_frames);
+			has_limit = true;
+		} else if (std::strcmp(argv[i], "--cycles-per-frame") == 0 && has_value) {
+			is_valid = parse_number(argv[++i], options.cycles_per_frame) && options.cycles_per_frame > 0;
+		} else if (std::strcmp(argv[i], "--until-pc") == 0 && has_value) {
+			size_t address{};
+			is_valid = parse_number(argv[++i], address, 16) && address < memory_in_bytes;
+			options.stop_at_program_counter = true;
+			options.stop_program_counter = address;
+			has_limit = true;
+		} else if (std::strcmp(argv[i], "--no-halt") == 0) {
+			options.stop_on_halt = false;
+		} else if (std::strcmp(argv[i], "--keys") == 0 && has_value) {
+			if (!load_key_trace(argv[++i], key_trace, number_of_keys))
+				return EXIT_FAILURE;
+		} else if (std::strcmp(argv[i], "--pbm") == 0 && has_value) {
+			pbm_filename = argv[++i];
+		} else if (std::strcmp(argv[i], "--render") == 0) {
+			render = true;
+		} else {
+			is_valid = false;
+		}
+		if (!is_valid) {
+			std::cerr << "Invalid argument: " << argv[i] << '\n';
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (!has_limit)
+		options.max_frames = 600;
+
+	const auto program = chip.load_program(argv[1]);
+	if (program.empty())
+		return EXIT_FAILURE;
+	chip.load_memory(program);
+
+	std::unique_ptr<TerminalRenderer<width_in_pixels, height_in_pixels>> renderer;
+	if (render) {
+		renderer = std::make_unique<TerminalRenderer<width_in_pixels, height_in_pixels>>(std::cerr);
+		options.on_frame = [&]() { renderer->publish(chip.get_graphics()); };
+	}
+	const auto result = run_frames(chip, options, key_trace);
+	if (renderer) {
+		renderer->publish(chip.get_graphics());
+		renderer->stop();
+		std::cout << "rendered frames: " << renderer->drawn_frames() << " of " << renderer->published_frames() << '\n';
+	}
+	const double seconds = std::max(result.seconds, 1e-9);
+	std::cout << "stop: " << to_string(result.stop);
+	if (result.stop == RunStop::Trap)
+		std::cout << " (" << to_string(result.trap) << ')';
+	std::cout << '\n'
+	          << "cycles: " << result.cycles << " (" << result.skipped_cycles << " fast-forwarded)\n"
+	          << "frames: " << result.frames << '\n'
+	          << "seconds: " << result.seconds << '\n'
+	          << "MIPS: " << (result.cycles - result.skipped_cycles) / seconds / 1e6 << " interpreted, "
+	          << result.cycles / seconds / 1e6 << " effective\n"
+	          << "frames/sec: " << result.frames / seconds << '\n'
+	          << "program counter: 0x" << std::hex << chip.get_program_counter() << '\n'
+	          << "framebuffer hash: " << fnv1a_hash(chip.get_graphics()) << std::dec << std::endl;
+
+	if (!pbm_filename.empty() && !write_pbm(chip, width_in_pixels, height_in_pixels, pbm_filename)) {
+		std::cerr << "Failed to write file: " << pbm_filename << std::endl;
+		return EXIT_FAILURE;
+	}
+	return result.stop == RunStop::Trap ? EXIT_FAILURE : EXIT_SUCCESS;
 }
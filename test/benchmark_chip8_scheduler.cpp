@@ -0,0 +1,51 @@
+//
+// Created by andreas on 18.10.26.
+//
+// Runs many machines in one thread through Chip8Scheduler and reports how many of them one core services at 60 fps.
+// Usage: benchmark_chip8_scheduler [MACHINES] [FRAMES]
+
+#include <chrono>
+#include <memory>
+#include "./../chip8/chip8.h"
+#include "./../chip8/chip8_coroutine.h"
+
+using Chip8Type = Chip8<4096, 16, 64, 32, 16, 16>;
+
+// Clears the screen and draws the digits 0 to F one after the other, forever
+const std::vector<unsigned char> program{0x00, 0xE0, 0xF0, 0x29, 0xD1, 0x15, 0x70, 0x01, 0x62, 0x0F, 0x80, 0x22,
+                                         0x12, 0x00};
+
+Chip8Task run_machine(Chip8CoroutineMachine<Chip8Type> &machine) {
+    while (true)
+        co_await machine.run_until_frame();
+}
+
+int main(int argc, char **argv) {
+    const size_t number_of_machines = argc > 1 ? std::stoul(argv[1]) : 10000;
+    const size_t number_of_frames = argc > 2 ? std::stoul(argv[2]) : 60;
+
+    Chip8Scheduler scheduler;
+    std::vector<std::unique_ptr<Chip8Type>> chips;
+    std::vector<std::unique_ptr<Chip8CoroutineMachine<Chip8Type>>> machines;
+    std::vector<Chip8Task> tasks;
+    for (size_t i{}; i < number_of_machines; ++i) {
+        chips.push_back(std::make_unique<Chip8Type>());
+        chips.back()->load_memory(program);
+        machines.push_back(std::make_unique<Chip8CoroutineMachine<Chip8Type>>(*chips.back(), scheduler));
+        tasks.push_back(run_machine(*machines.back()));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t resumed{};
+    for (size_t frame{}; frame < number_of_frames; ++frame)
+        resumed += scheduler.run_frame();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double seconds_per_frame = seconds / number_of_frames;
+    std::cout << "machines: " << number_of_machines << '\n'
+              << "frames: " << number_of_frames << '\n'
+              << "resumes: " << resumed << '\n'
+              << "seconds per frame: " << seconds_per_frame << '\n'
+              << "machines per core at 60 fps: " << number_of_machines / (seconds_per_frame * 60.0) << std::endl;
+    return 0;
+}
@@ -0,0 +1,18 @@
+//
+// Created by andreas on 18.10.26.
+//
+
+#ifndef CHIP8_TEST_UTILS_H
+#define CHIP8_TEST_UTILS_H
+
+#include <array>
+#include <cstddef>
+
+// Writes a big endian opcode to a program which is loaded at the memory offset, memory_index is relative to it.
+template<typename Bit8, size_t size>
+void set_opcode_to_memory_index(const unsigned int opcode, std::array<Bit8, size> &memory, int memory_index) {
+    memory[memory_index] = (opcode >> 8) & 0xFF;
+    memory[memory_index + 1] = opcode & 0xFF;
+}
+
+#endif //CHIP8_TEST_UTILS_H
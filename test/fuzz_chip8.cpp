@@ -0,0 +1,210 @@
+//
+// Created by andreas on 18.10.26.
+//
+// Differential fuzzer: runs an input through the reference interpreter (emulateCycle() through opcodeMap), the
+// fast-forwarding emulateCycles() and the debugger's instrumented opcodeMap, and compares the full state including
+// traps after every step. A divergence is minimized and the harness aborts.
+// Build with -DCHIP8_LIBFUZZER=ON and clang for libFuzzer, otherwise a standalone driver is built which either replays
+// the files given on the command line or runs a number of random inputs with a fixed seed.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include "./../chip8/chip8.h"
+#include "./../chip8/chip8_debugger.h"
+
+using Chip8Type = Chip8<4096, 16, 64, 32, 16, 16>;
+using Input = std::vector<uint8_t>;
+
+// Input layout: V0..VF, I (2 bytes), delay timer, sound timer, keypad (2 bytes), seed, trap policies (one bit per
+// trap, set ignores it), program loaded at 0x200.
+constexpr size_t state_size{24};
+constexpr size_t number_of_steps{64};
+constexpr size_t max_cycles_per_step{16};
+
+class Chip8Fuzzer {
+public:
+    struct Snapshot {
+        std::array<Chip8Type::Bit8, 4096> memory;
+        std::array<Chip8Type::Bit8, 16> registers;
+        std::array<Chip8Type::Bit8, 64 * 32> graphics;
+        std::array<Chip8Type::Bit16, 16> stack;
+        Chip8Type::Bit16 current_opcode;
+        Chip8Type::Bit16 index_register;
+        Chip8Type::Bit16 program_counter;
+        Chip8Type::Bit8 stack_pointer;
+        Chip8Type::Bit8 delayed_timer;
+        Chip8Type::Bit8 sound_timer;
+        Trap trap;
+    };
+
+    static void set_up(Chip8Type &chip, const Input &input) {
+        for (size_t i{}; i < 16; ++i)
+            chip.registers[i] = input[i];
+        chip.index_register = (input[16] << 8 | input[17]) & 0x0FFF;
+        chip.delayed_timer = input[18];
+        chip.sound_timer = input[19];
+        for (size_t key{}; key < 16; ++key)
+            chip.keypad[key] = ((input[20] << 8 | input[21]) >> key) & 0x1;
+        for (size_t trap{1}; trap < number_of_traps; ++trap) {
+            const bool is_ignored = (input[23] >> trap) & 0x1;
+            chip.set_trap_policy(static_cast<Trap>(trap), is_ignored ? TrapPolicy::Ignore : TrapPolicy::Halt);
+        }
+        for (size_t i{state_size}; i < input.size() && i - state_size < 4096 - 512; ++i)
+            chip.memory[512 + i - state_size] = input[i];
+    }
+
+    static Snapshot snapshot(const Chip8Type &chip) {
+        return {chip.memory, chip.registers, chip.graphics, chip.stack, chip.current_opcode, chip.index_register,
+                chip.program_counter, chip.stack_pointer, chip.delayed_timer, chip.sound_timer, chip.trap};
+    }
+
+    // Returns the first differing field of two snapshots, or an empty string.
+    static std::string compare(const Snapshot &expected, const Snapshot &actual) {
+        if (expected.trap != actual.trap) return "trap";
+        if (expected.program_counter != actual.program_counter) return "program_counter";
+        if (expected.current_opcode != actual.current_opcode) return "current_opcode";
+        if (expected.index_register != actual.index_register) return "index_register";
+        if (expected.stack_pointer != actual.stack_pointer) return "stack_pointer";
+        if (expected.delayed_timer != actual.delayed_timer) return "delayed_timer";
+        if (expected.sound_timer != actual.sound_timer) return "sound_timer";
+        if (expected.registers != actual.registers) return "registers";
+        if (expected.stack != actual.stack) return "stack";
+        if (expected.memory != actual.memory) return "memory";
+        if (expected.graphics != actual.graphics) return "graphics";
+        return {};
+    }
+
+    // Returns a description of the first divergence between the engines, or an empty string.
+    static std::string run(const Input &input) {
+        if (input.size() < state_size)
+            return {};
+        Chip8Type reference;
+        Chip8Type fast_forward;
+        Chip8Type instrumented;
+        set_up(reference, input);
+        set_up(fast_forward, input);
+        set_up(instrumented, input);
+        Chip8Debugger<Chip8Type> debugger(instrumented);
+        debugger.add_register_watchpoint(0, [](Chip8Type::Bit8, Chip8Type::Bit8) { return false; });
+
+        std::minstd_rand random(input[22] + 1);
+        for (size_t step{}; step < number_of_steps; ++step) {
+            if (random() % 8 == 0) {
+                const size_t key = random() % 16;
+                const bool is_pressed = reference.keypad[key] == 0;
+                reference.set_key(key, is_pressed);
+                fast_forward.set_key(key, is_pressed);
+                instrumented.set_key(key, is_pressed);
+            }
+            const unsigned int seed = random();
+            const size_t cycles = 1 + random() % max_cycles_per_step;
+
+            srand(seed);
+            for (size_t cycle{}; cycle < cycles; ++cycle) {
+                if (reference.emulateCycle() != Trap::None)
+                    break;
+            }
+            srand(seed);
+            fast_forward.emulateCycles(cycles);
+            srand(seed);
+            debugger.run(cycles);
+
+            const auto expected = snapshot(reference);
+            std::string difference = compare(expected, snapshot(fast_forward));
+            if (!difference.empty())
+                return "emulateCycles() differs in " + difference + " at step " + std::to_string(step);
+            difference = compare(expected, snapshot(instrumented));
+            if (!difference.empty())
+                return "instrumented opcodeMap differs in " + difference + " at step " + std::to_string(step);
+            if (reference.get_trap() != Trap::None)
+                return {};
+        }
+        return {};
+    }
+
+    // Removes instructions and clears bytes as long as the input keeps diverging.
+    static Input minimize(Input input) {
+        bool has_shrunk{true};
+        while (has_shrunk) {
+            has_shrunk = false;
+            for (size_t i{state_size}; i + 1 < input.size();) {
+                Input candidate(input);
+                candidate.erase(candidate.begin() + i, candidate.begin() + i + 2);
+                if (!run(candidate).empty()) {
+                    input = candidate;
+                    has_shrunk = true;
+                } else {
+                    i += 2;
+                }
+            }
+            for (size_t i{}; i < input.size(); ++i) {
+                if (input[i] == 0)
+                    continue;
+                Input candidate(input);
+                candidate[i] = 0;
+                if (!run(candidate).empty()) {
+                    input = candidate;
+                    has_shrunk = true;
+                }
+            }
+        }
+        return input;
+    }
+
+    static void check(const Input &input) {
+        if (run(input).empty())
+            return;
+        const Input minimized = minimize(input);
+        std::ostringstream bytes;
+        for (auto byte: minimized)
+            bytes << std::hex << static_cast<int>(byte) << ' ';
+        std::cerr << "Divergence: " << run(minimized) << "\nMinimized input: " << bytes.str() << std::endl;
+        std::abort();
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    Chip8Fuzzer::check(Input(data, data + size));
+    return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+int main(int argc, char **argv) {
+    const std::string first_argument = argc > 1 ? argv[1] : "1000";
+    if (argc > 1 && first_argument.find_first_not_of("0123456789") != std::string::npos) {
+        for (int i{1}; i < argc; ++i) {
+            std::ifstream file(argv[i], std::ios::binary);
+            const Input input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            Chip8Fuzzer::check(input);
+        }
+        return 0;
+    }
+
+    const size_t number_of_inputs = std::stoul(first_argument);
+    std::mt19937 random(0xC8);
+    for (size_t i{}; i < number_of_inputs; ++i) {
+        Input input(state_size + random() % 512);
+        for (auto &byte: input)
+            byte = random();
+        // Plant idle loops now and then, random bytes hardly ever form one.
+        if (input.size() >= state_size + 8 && random() % 2 == 0) {
+            const size_t offset = state_size + 2 * (random() % ((input.size() - state_size - 6) / 2));
+            const size_t address = 512 + offset - state_size;
+            const int x = random() % 16;
+            const bool is_key_wait = random() % 4 == 0;
+            input[offset] = 0xF0 | x;
+            input[offset + 1] = is_key_wait ? 0x0A : 0x07;
+            input[offset + 2] = 0x30 | x;
+            input[offset + 3] = 0x00;
+            input[offset + 4] = 0x10 | (address >> 8);
+            input[offset + 5] = address & 0xFF;
+        }
+        Chip8Fuzzer::check(input);
+    }
+    std::cout << "No divergence in " << number_of_inputs << " inputs" << std::endl;
+    return 0;
+}
+#endif
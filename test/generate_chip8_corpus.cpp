@@ -0,0 +1,67 @@
+//
+// Created by andreas on 18.10.26.
+//
+// Writes the synthetic ROMs of the corpus test into the directory given as argument.
+// The ROMs avoid CXNN, rand() is shared by the threads of the corpus runner.
+
+#include <cerrno>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Rom {
+    std::string name;
+    std::vector<unsigned short> opcodes;
+};
+
+const std::vector<Rom> roms{
+        // Draws the digits 0 to B in a row
+        {"digits",    {0x6000, 0x6100, 0x6202, 0xF029, 0xD125, 0x7105, 0x7001, 0x300C, 0x1206, 0x1212}},
+        // Two register operations, the registers are stored at 0x300 and drawn as sprites
+        {"arithmetic", {0x6A5C, 0x6B3A, 0x8AB4, 0x8CA0, 0x8CB5, 0x8DA0, 0x8D06, 0x8EA0, 0x8E07, 0x8BCE, 0x8CA1,
+                               0x8DA2, 0x8EA3, 0xA300, 0xFF55, 0xA300, 0x6000, 0x6100, 0xD018, 0xA308, 0x6008,
+                               0xD018, 0x122C}},
+        // Binary-coded decimal of V3 drawn as digits, V3 advances by 37 per row
+        {"bcd",       {0x6300, 0x6500, 0xA300, 0xF333, 0xF265, 0x6400, 0xF029, 0xD455, 0x7405, 0xF129, 0xD455,
+                              0x7405, 0xF229, 0xD455, 0x7506, 0x7325, 0x351E, 0x1204, 0x1224}},
+        // Nested subroutine calls drawing pairs of boxes
+        {"subroutine", {0x6100, 0x6200, 0x2210, 0x7208, 0x3218, 0x1204, 0x120C, 0x0000, 0x2218, 0x7108, 0x2218,
+                               0x00EE, 0xA21E, 0xD124, 0x00EE, 0xF090, 0x90F0}},
+        // Delay timer polling loop, the digit of a counter is drawn after every expiry
+        {"timer",     {0x6600, 0x6A0F, 0xFA15, 0xFB07, 0x3B00, 0x1206, 0x00E0, 0xF629, 0x6100, 0xD115, 0x7601,
+                              0x3610, 0x1204, 0x121A}},
+        // Drawing the same sprite twice collides and erases it, VF is kept in VD and VE
+        {"collision", {0xA212, 0x6005, 0x6105, 0xD012, 0xD012, 0x8DF0, 0xD012, 0x8EF0, 0x1210, 0xC3C3}},
+        // Draws "A" and waits for a key which is never pressed
+        {"keywait",   {0x600A, 0xF029, 0xD005, 0xF30A, 0x6401, 0x120A}},
+        // Fills memory at 0x300 with FX55 and draws it
+        {"memory",    {0xA300, 0x6000, 0x6200, 0x701D, 0xF055, 0x7201, 0x3210, 0x1206, 0xA300, 0x6320, 0x6408,
+                              0xD34F, 0x1218}},
+};
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " DIRECTORY" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string directory = argv[1];
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create directory: " << directory << std::endl;
+        return EXIT_FAILURE;
+    }
+    for (const auto &rom: roms) {
+        std::ofstream file(directory + "/" + rom.name + ".ch8", std::ios::binary);
+        for (auto opcode: rom.opcodes) {
+            file.put(static_cast<char>(opcode >> 8));
+            file.put(static_cast<char>(opcode & 0xFF));
+        }
+        if (!file) {
+            std::cerr << "Failed to write file: " << rom.name << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
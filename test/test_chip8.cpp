@@ -3,6 +3,7 @@
 //
 #include "gtest/gtest.h"
 #include "./../chip8/chip8.h"
+#include "chip8_test_utils.h"
 
 class Chip8Test {
 public:
@@ -74,16 +75,28 @@ public:
         chip8.registers[register_index] = value;
     }
 
-};
+    const std::array<Bit8, number_of_registers> &get_registers() const {
+        return chip8.registers;
+    }
 
+    Bit16 get_index_register() const {
+        return chip8.index_register;
+    }
+
+    Bit8 get_stack_pointer() const {
+        return chip8.stack_pointer;
+    }
+
+    Bit8 get_delay_timer() const {
+        return chip8.delayed_timer;
+    }
+
+    Bit8 get_sound_timer() const {
+        return chip8.sound_timer;
+    }
+
+};
 
-void set_opcode_to_memory_index(const unsigned int opcode, std::array<Chip8Test::Bit8,
-        Chip8Test::memory_in_bytes - Chip8Test::memory_offset> &memory, int memory_index) {
-    Chip8Test::Bit8 high_byte = (opcode >> 8) & 0xFF;
-    Chip8Test::Bit8 low_byte = opcode & 0xFF;
-    memory[memory_index] = high_byte;
-    memory[memory_index + 1] = low_byte;
-}
 
 TEST(TestChip8, SetProgramCounterToAddress) {
     Chip8Test chip8;
@@ -415,3 +428,166 @@ TEST(TestChip8, TwoRegisterOperationsAssignXORValueinRegister5ToRegister0) {
     EXPECT_NE(chip8.get_register_value(register_index0), 0xAA);
     EXPECT_EQ(chip8.get_register_value(register_index0), 0x8B);
 }
+
+void expect_same_state(const Chip8Test &expected, const Chip8Test &actual) {
+    EXPECT_EQ(expected.get_current_opcode(), actual.get_current_opcode());
+    EXPECT_EQ(expected.get_program_counter(), actual.get_program_counter());
+    EXPECT_EQ(expected.get_index_register(), actual.get_index_register());
+    EXPECT_EQ(expected.get_stack_pointer(), actual.get_stack_pointer());
+    EXPECT_EQ(expected.get_delay_timer(), actual.get_delay_timer());
+    EXPECT_EQ(expected.get_sound_timer(), actual.get_sound_timer());
+    EXPECT_EQ(expected.get_registers(), actual.get_registers());
+    EXPECT_EQ(expected.get_stack(), actual.get_stack());
+    EXPECT_EQ(expected.get_memory(), actual.get_memory());
+    EXPECT_EQ(expected.get_graphics(), actual.get_graphics());
+}
+
+TEST(TestChip8, FastForwardDelayTimerPollingLoopMatchesSingleCycles) {
+    std::array<Chip8Test::Bit8, Chip8Test::memory_in_bytes - Chip8Test::memory_offset> memory{};
+    // VA = 0x0B, delay timer = VA, sound timer = VA
+    set_opcode_to_memory_index(0x6A0B, memory, 0);
+    set_opcode_to_memory_index(0xFA15, memory, 2);
+    set_opcode_to_memory_index(0xFA18, memory, 4);
+    // 0x206: VB = delay timer; skip if VB == 0; jump to 0x206
+    set_opcode_to_memory_index(0xFB07, memory, 6);
+    set_opcode_to_memory_index(0x3B00, memory, 8);
+    set_opcode_to_memory_index(0x1206, memory, 10);
+    // VC = 1 and jump to itself
+    set_opcode_to_memory_index(0x6C01, memory, 12);
+    set_opcode_to_memory_index(0x120E, memory, 14);
+    for (size_t number_of_cycles{}; number_of_cycles < 40; ++number_of_cycles) {
+        Chip8Test expected;
+        Chip8Test actual;
+        expected.load_memory(memory);
+        actual.load_memory(memory);
+        for (size_t cycle{}; cycle < number_of_cycles; ++cycle)
+            expected.chip8.emulateCycle();
+        actual.chip8.emulateCycles(number_of_cycles);
+        expect_same_state(expected, actual);
+    }
+    Chip8Test chip8;
+    chip8.load_memory(memory);
+    EXPECT_GT(chip8.chip8.emulateCycles(40).skipped_cycles, 0);
+    EXPECT_EQ(chip8.get_register_value(0xC), 1);
+}
+
+TEST(TestChip8, FastForwardKeyWaitMatchesSingleCycles) {
+    std::array<Chip8Test::Bit8, Chip8Test::memory_in_bytes - Chip8Test::memory_offset> memory{};
+    // delay timer = VA = 0x20, wait for key in V3, V4 = 1
+    set_opcode_to_memory_index(0x6A20, memory, 0);
+    set_opcode_to_memory_index(0xFA15, memory, 2);
+    set_opcode_to_memory_index(0xF30A, memory, 4);
+    set_opcode_to_memory_index(0x6401, memory, 6);
+    Chip8Test expected;
+    Chip8Test actual;
+    expected.load_memory(memory);
+    actual.load_memory(memory);
+    constexpr size_t number_of_cycles{100};
+    for (size_t cycle{}; cycle < number_of_cycles; ++cycle)
+        expected.chip8.emulateCycle();
+    EXPECT_EQ(actual.chip8.emulateCycles(number_of_cycles).skipped_cycles, number_of_cycles - 2);
+    EXPECT_TRUE(actual.chip8.is_waiting_for_key());
+    expect_same_state(expected, actual);
+    EXPECT_EQ(actual.get_program_counter(), Chip8Test::start_program_counter() + 4);
+
+    expected.chip8.set_key(0x7, true);
+    actual.chip8.set_key(0x7, true);
+    expected.chip8.emulateCycle();
+    expected.chip8.emulateCycle();
+    actual.chip8.emulateCycles(2);
+    expect_same_state(expected, actual);
+    EXPECT_EQ(actual.get_register_value(3), 0x7);
+    EXPECT_EQ(actual.get_register_value(4), 1);
+}
+
+TEST(TestChip8, InvalidOpcodeHaltsWithTrap) {
+    Chip8Test chip8;
+    std::array<Chip8Test::Bit8, Chip8Test::memory_in_bytes - Chip8Test::memory_offset> memory{};
+    set_opcode_to_memory_index(0x6A01, memory, 0);
+    set_opcode_to_memory_index(0x8AB9, memory, 2);
+    chip8.load_memory(memory);
+    EXPECT_EQ(chip8.chip8.emulateCycle(), Trap::None);
+    EXPECT_EQ(chip8.chip8.emulateCycle(), Trap::InvalidOpcode);
+    EXPECT_EQ(chip8.chip8.get_trap(), Trap::InvalidOpcode);
+    EXPECT_EQ(chip8.get_program_counter(), chip8.start_program_counter() + 2);
+    // A halted machine does not execute anymore
+    const auto result = chip8.chip8.emulateCycles(10);
+    EXPECT_EQ(result.cycles, 0);
+    EXPECT_EQ(result.trap, Trap::InvalidOpcode);
+    EXPECT_EQ(chip8.get_program_counter(), chip8.start_program_counter() + 2);
+}
+
+TEST(TestChip8, IgnoredTrapSkipsInstruction) {
+    Chip8Test chip8;
+    std::array<Chip8Test::Bit8, Chip8Test::memory_in_bytes - Chip8Test::memory_offset> memory{};
+    set_opcode_to_memory_index(0x00EE, memory, 0);
+    set_opcode_to_memory_index(0xE1FF, memory, 2);
+    set_opcode_to_memory_index(0x6A01, memory, 4);
+    chip8.load_memory(memory);
+    chip8.chip8.set_trap_policy(Trap::StackUnderflow, TrapPolicy::Ignore);
+    chip8.chip8.set_trap_policy(Trap::InvalidOpcode, TrapPolicy::Ignore);
+    const auto result = chip8.chip8.emulateCycles(3);
+    EXPECT_EQ(result.cycles, 3);
+    EXPECT_EQ(result.trap, Trap::None);
+    EXPECT_EQ(chip8.get_stack_pointer(), 0);
+    EXPECT_EQ(chip8.get_register_value(0xA), 1);
+    EXPECT_EQ(chip8.get_program_counter(), chip8.start_program_counter() + 6);
+}
+
+TEST(TestChip8, TrapHandlerDecidesPolicy) {
+    Chip8Test chip8;
+    std::array<Chip8Test::Bit8, Chip8Test::memory_in_bytes - Chip8Test::memory_offset> memory{};
+    // Calls itself until the stack overflows, an ignored call continues with the jump back
+    set_opcode_to_memory_index(0x2200, memory, 0);
+    set_opcode_to_memory_index(0x1200, memory, 2);
+    chip8.load_memory(memory);
+    std::vector<Trap> traps;
+    chip8.chip8.set_trap_policy(Trap::StackOverflow, TrapPolicy::Callback);
+    chip8.chip8.set_trap_handler([&traps](Trap trap) {
+        traps.push_back(trap);
+        return traps.size() < 2 ? TrapPolicy::Ignore : TrapPolicy::Halt;
+    });
+    const auto result = chip8.chip8.emulateCycles(100);
+    EXPECT_EQ(result.trap, Trap::StackOverflow);
+    EXPECT_EQ(traps.size(), 2);
+    EXPECT_EQ(chip8.get_stack_pointer(), Chip8Test::number_of_stack_levels);
+    EXPECT_EQ(result.cycles, Chip8Test::number_of_stack_levels + 2);
+    EXPECT_EQ(chip8.get_program_counter(), chip8.start_program_counter());
+}
+
+TEST(TestChip8, MemoryOutOfRangeTraps) {
+    Chip8Test chip8;
+    std::array<Chip8Test::Bit8, Chip8Test::memory_in_bytes - Chip8Test::memory_offset> memory{};
+    // I = 0xFFE; store V0..V2 at I
+    set_opcode_to_memory_index(0xAFFE, memory, 0);
+    set_opcode_to_memory_index(0xF255, memory, 2);
+    chip8.load_memory(memory);
+    chip8.set_register_value(0, 0x11);
+    const auto result = chip8.chip8.emulateCycles(2);
+    EXPECT_EQ(result.cycles, 1);
+    EXPECT_EQ(result.trap, Trap::MemoryOutOfRange);
+    EXPECT_EQ(chip8.get_memory()[0xFFE], 0);
+    EXPECT_EQ(chip8.get_index_register(), 0xFFE);
+}
+
+TEST(TestChip8, SkipIfKeyNotPressedDoesNotTrap) {
+    Chip8Test chip8;
+    std::array<Chip8Test::Bit8, Chip8Test::memory_in_bytes - Chip8Test::memory_offset> memory{};
+    set_opcode_to_memory_index(0xE09E, memory, 0);
+    set_opcode_to_memory_index(0xE0A1, memory, 2);
+    chip8.load_memory(memory);
+    EXPECT_EQ(chip8.chip8.emulateCycle(), Trap::None);
+    EXPECT_EQ(chip8.get_program_counter(), chip8.start_program_counter() + 2);
+    EXPECT_EQ(chip8.chip8.emulateCycle(), Trap::None);
+    EXPECT_EQ(chip8.get_program_counter(), chip8.start_program_counter() + 6);
+}
+
+TEST(TestChip8, SetKeyOutOfRangeIsRejected) {
+    Chip8Test chip8;
+    EXPECT_TRUE(chip8.chip8.set_key(Chip8Test::number_of_keys - 1, true));
+    EXPECT_FALSE(chip8.chip8.set_key(Chip8Test::number_of_keys, true));
+    EXPECT_FALSE(chip8.chip8.set_key(200, true));
+    std::array<Chip8Test::Bit8, Chip8Test::number_of_keys> expected_keypad{};
+    expected_keypad[Chip8Test::number_of_keys - 1] = 1;
+    EXPECT_EQ(chip8.get_keypad(), expected_keypad);
+}
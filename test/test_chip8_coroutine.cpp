@@ -0,0 +1,147 @@
+//
+// Created by andreas on 18.10.26.
+//
+#include <memory>
+#include <optional>
+#include "gtest/gtest.h"
+#include "./../chip8/chip8.h"
+#include "./../chip8/chip8_coroutine.h"
+
+using Chip8Type = Chip8<4096, 16, 64, 32, 16, 16>;
+constexpr size_t cycles_per_frame{10};
+
+// V0 = 5; delay and sound timer = 0xFF; wait for key in V3; draw digit V3 at (V0, V0); jump to itself
+const std::vector<unsigned char> program{0x60, 0x05, 0x6A, 0xFF, 0xFA, 0x15, 0xFA, 0x18, 0xF3, 0x0A, 0xF3, 0x29,
+                                         0xD0, 0x05, 0x12, 0x0E};
+
+Chip8Task run_machine(Chip8CoroutineMachine<Chip8Type> &machine, size_t frames, size_t &key_waits) {
+    for (size_t frame{}; frame < frames; ++frame) {
+        if (co_await machine.run_until_frame() == FrameResult::KeyWait)
+            ++key_waits;
+    }
+}
+
+TEST(TestChip8Coroutine, ParksMachineWaitingForKey) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    Chip8Scheduler scheduler;
+    Chip8CoroutineMachine<Chip8Type> machine(chip, scheduler, cycles_per_frame);
+    size_t key_waits{};
+    auto task = run_machine(machine, 20, key_waits);
+
+    EXPECT_EQ(scheduler.run_frame(), 1);
+    EXPECT_EQ(key_waits, 1);
+    EXPECT_EQ(scheduler.run_frame(), 0);
+    EXPECT_TRUE(machine.is_parked());
+    EXPECT_EQ(scheduler.run_frame(), 0);
+    EXPECT_FALSE(machine.set_key(200, true));
+    EXPECT_TRUE(machine.is_parked());
+    EXPECT_EQ(scheduler.run_frame(), 0);
+    EXPECT_FALSE(task.done());
+}
+
+TEST(TestChip8Coroutine, KeyPressMatchesContinuousEmulation) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    Chip8Scheduler scheduler;
+    Chip8CoroutineMachine<Chip8Type> machine(chip, scheduler, cycles_per_frame);
+    size_t key_waits{};
+    auto task = run_machine(machine, 20, key_waits);
+    // Parked after frame 0, frames 1 to 3 are caught up by set_key() before frame 4
+    constexpr size_t key_frame{4};
+    constexpr size_t number_of_frames{12};
+    for (size_t frame{}; frame < key_frame; ++frame)
+        scheduler.run_frame();
+    EXPECT_TRUE(machine.is_parked());
+    machine.set_key(0x7, true);
+    EXPECT_FALSE(machine.is_parked());
+    for (size_t frame{key_frame}; frame < number_of_frames; ++frame)
+        EXPECT_EQ(scheduler.run_frame(), 1);
+    EXPECT_FALSE(task.done());
+
+    Chip8Type expected;
+    expected.load_memory(program);
+    for (size_t frame{}; frame < number_of_frames; ++frame) {
+        if (frame == key_frame)
+            expected.set_key(0x7, true);
+        expected.emulateCycles(cycles_per_frame);
+    }
+
+    EXPECT_EQ(key_waits, 1);
+    // The timers are still running, they show whether both sides ran the same number of cycles
+    EXPECT_GT(expected.get_delay_timer(), 0);
+    EXPECT_EQ(chip.get_delay_timer(), expected.get_delay_timer());
+    EXPECT_EQ(chip.get_sound_timer(), expected.get_sound_timer());
+    EXPECT_EQ(chip.get_program_counter(), expected.get_program_counter());
+    EXPECT_EQ(chip.get_registers(), expected.get_registers());
+    EXPECT_EQ(chip.get_graphics(), expected.get_graphics());
+}
+
+TEST(TestChip8Coroutine, DestroyedTaskIsNotResumed) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    Chip8Scheduler scheduler;
+    Chip8CoroutineMachine<Chip8Type> machine(chip, scheduler, cycles_per_frame);
+    size_t key_waits{};
+    {
+        auto task = run_machine(machine, 20, key_waits);
+        EXPECT_EQ(scheduler.scheduled(), 1);
+        EXPECT_TRUE(machine.is_waiting());
+    }
+    EXPECT_EQ(scheduler.scheduled(), 0);
+    EXPECT_FALSE(machine.is_waiting());
+    EXPECT_EQ(scheduler.run_frame(), 0);
+    // A parked task is dropped as well
+    {
+        auto task = run_machine(machine, 20, key_waits);
+        scheduler.run_frame();
+        EXPECT_TRUE(machine.is_parked());
+    }
+    EXPECT_FALSE(machine.is_parked());
+    machine.set_key(0x7, true);
+    EXPECT_EQ(scheduler.scheduled(), 0);
+}
+
+TEST(TestChip8Coroutine, CancelledMachineIsNotResumed) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    Chip8Scheduler scheduler;
+    size_t key_waits{};
+    auto machine = std::make_unique<Chip8CoroutineMachine<Chip8Type>>(chip, scheduler, cycles_per_frame);
+    auto task = run_machine(*machine, 20, key_waits);
+    machine->cancel();
+    EXPECT_EQ(scheduler.run_frame(), 0);
+    EXPECT_FALSE(task.done());
+
+    auto other_machine = std::make_unique<Chip8CoroutineMachine<Chip8Type>>(chip, scheduler, cycles_per_frame);
+    auto other_task = run_machine(*other_machine, 20, key_waits);
+    other_machine.reset();
+    EXPECT_EQ(scheduler.run_frame(), 0);
+    // Destroying the task after its machine must not touch the machine
+    other_task = run_machine(*machine, 20, key_waits);
+    EXPECT_EQ(scheduler.run_frame(), 1);
+}
+
+// Destroys the other task from within the frame in which both are resumed
+Chip8Task run_and_destroy(Chip8CoroutineMachine<Chip8Type> &machine, std::optional<Chip8Task> &other) {
+    co_await machine.run_until_frame();
+    other.reset();
+    co_await machine.run_until_frame();
+}
+
+TEST(TestChip8Coroutine, TaskDestroyedDuringFrameIsNotResumed) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    Chip8Type other_chip;
+    other_chip.load_memory(program);
+    Chip8Scheduler scheduler;
+    Chip8CoroutineMachine<Chip8Type> machine(chip, scheduler, cycles_per_frame);
+    Chip8CoroutineMachine<Chip8Type> other_machine(other_chip, scheduler, cycles_per_frame);
+    size_t key_waits{};
+    std::optional<Chip8Task> other;
+    auto task = run_and_destroy(machine, other);
+    other.emplace(run_machine(other_machine, 20, key_waits));
+    EXPECT_EQ(scheduler.run_frame(), 1);
+    EXPECT_FALSE(other.has_value());
+    EXPECT_EQ(key_waits, 0);
+}
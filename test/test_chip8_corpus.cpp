@@ -0,0 +1,136 @@
+//
+// Created by andreas on 18.10.26.
+//
+// Runs every ROM of a directory for fixed frame counts and compares hashes of graphics and registers at each
+// checkpoint against a golden file. ROMs are distributed over all cores.
+// Usage: test_chip8_corpus ROM_DIRECTORY GOLDEN_FILE [--update]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <dirent.h>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include "./../chip8/chip8.h"
+#include "./../chip8/chip8_runner.h"
+
+using Chip8Type = Chip8<4096, 16, 64, 32, 16, 16>;
+
+constexpr size_t checkpoint_frames[]{1, 10, 60, 600};
+
+std::vector<std::string> list_roms(const std::string &directory) {
+    std::vector<std::string> roms;
+    DIR *handle = opendir(directory.c_str());
+    if (handle == nullptr)
+        return roms;
+    while (const dirent *entry = readdir(handle)) {
+        const std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".ch8") == 0)
+            roms.push_back(name);
+    }
+    closedir(handle);
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+// One line per checkpoint: "rom frame graphics_hash state_hash"
+std::string run_rom(const std::string &directory, const std::string &rom) {
+    Chip8Type chip;
+    const auto program = chip.load_program(directory + "/" + rom);
+    chip.load_memory(program);
+    RunOptions options;
+    options.stop_on_halt = false;
+
+    std::ostringstream lines;
+    size_t frame{};
+    for (auto checkpoint: checkpoint_frames) {
+        options.max_frames = checkpoint - frame;
+        const auto result = run_frames(chip, options);
+        frame += result.frames;
+        std::vector<unsigned char> state(chip.get_registers().begin(), chip.get_registers().end());
+        state.push_back(chip.get_index_register() >> 8);
+        state.push_back(chip.get_index_register() & 0xFF);
+        state.push_back(chip.get_program_counter() >> 8);
+        state.push_back(chip.get_program_counter() & 0xFF);
+        state.push_back(chip.get_stack_pointer());
+        lines << rom << ' ' << std::dec << frame << ' ' << std::hex << std::setw(16) << std::setfill('0')
+              << fnv1a_hash(chip.get_graphics()) << ' ' << std::setw(16) << fnv1a_hash(state) << '\n';
+        if (result.stop == RunStop::Trap)
+            break;
+    }
+    return lines.str();
+}
+
+std::map<std::string, std::string> load_golden(const std::string &filename) {
+    std::map<std::string, std::string> golden;
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty())
+            continue;
+        golden[line.substr(0, line.find(' '))] += line + '\n';
+    }
+    return golden;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " ROM_DIRECTORY GOLDEN_FILE [--update]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string directory = argv[1];
+    const std::string golden_filename = argv[2];
+    const bool update = argc > 3 && std::string(argv[3]) == "--update";
+
+    const auto roms = list_roms(directory);
+    if (roms.empty()) {
+        std::cerr << "No ROMs in " << directory << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> results(roms.size());
+    std::atomic<size_t> next_rom{0};
+    std::vector<std::thread> workers;
+    const size_t number_of_workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                                          roms.size()));
+    for (size_t worker{}; worker < number_of_workers; ++worker) {
+        workers.emplace_back([&]() {
+            for (size_t rom = next_rom++; rom < roms.size(); rom = next_rom++)
+                results[rom] = run_rom(directory, roms[rom]);
+        });
+    }
+    for (auto &worker: workers)
+        worker.join();
+
+    if (update) {
+        std::ofstream file(golden_filename);
+        for (const auto &result: results)
+            file << result;
+        std::cout << "Wrote golden results of " << roms.size() << " ROMs to " << golden_filename << std::endl;
+        return file ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    auto golden = load_golden(golden_filename);
+    size_t failures{};
+    for (size_t rom{}; rom < roms.size(); ++rom) {
+        const auto expected = golden.find(roms[rom]);
+        if (expected == golden.end()) {
+            std::cerr << "No golden results for " << roms[rom] << std::endl;
+            ++failures;
+        } else if (expected->second != results[rom]) {
+            std::cerr << "Mismatch for " << roms[rom] << "\nexpected:\n" << expected->second << "actual:\n"
+                      << results[rom];
+            ++failures;
+        }
+        if (expected != golden.end())
+            golden.erase(expected);
+    }
+    for (const auto &missing: golden) {
+        std::cerr << "Missing ROM " << missing.first << std::endl;
+        ++failures;
+    }
+    std::cout << roms.size() - std::min(failures, roms.size()) << " of " << roms.size() << " ROMs match"
+              << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,156 @@
+//
+// Created by andreas on 18.10.26.
+//
+#include "gtest/gtest.h"
+#include "./../chip8/chip8.h"
+#include "./../chip8/chip8_debugger.h"
+#include "chip8_test_utils.h"
+
+using Chip8Type = Chip8<4096, 16, 64, 32, 16, 16>;
+using Program = std::array<unsigned char, 4096 - 512>;
+
+Program create_program() {
+    Program memory{};
+    // 0x200: V0 = 0x11; call 0x20A; V2 = 0x33; jump to 0x206
+    set_opcode_to_memory_index(0x6011, memory, 0);
+    set_opcode_to_memory_index(0x220A, memory, 2);
+    set_opcode_to_memory_index(0x6233, memory, 4);
+    set_opcode_to_memory_index(0x1206, memory, 6);
+    // 0x20A: I = 0x300; store V0..V1 at I; V1 = 0x22; return
+    set_opcode_to_memory_index(0xA300, memory, 10);
+    set_opcode_to_memory_index(0xF155, memory, 12);
+    set_opcode_to_memory_index(0x6122, memory, 14);
+    set_opcode_to_memory_index(0x00EE, memory, 16);
+    return memory;
+}
+
+TEST(TestChip8Debugger, StopsAtBreakpoint) {
+    Chip8Type chip;
+    chip.load_memory(create_program());
+    Chip8Debugger<Chip8Type> debugger(chip);
+    debugger.add_breakpoint(0x20E);
+    EXPECT_FALSE(debugger.is_instrumented());
+    auto event = debugger.run(100);
+    EXPECT_EQ(event.reason, DebugStopReason::Breakpoint);
+    EXPECT_EQ(event.address, 0x20E);
+    EXPECT_EQ(event.cycles, 4);
+    // Resuming steps over the breakpoint
+    debugger.remove_breakpoint(0x20E);
+    debugger.add_breakpoint(0x206);
+    event = debugger.run(100);
+    EXPECT_EQ(event.reason, DebugStopReason::Breakpoint);
+    EXPECT_EQ(event.address, 0x206);
+}
+
+TEST(TestChip8Debugger, StopsAtBreakpointReachedOnLastCycleOfPreviousRun) {
+    Chip8Type chip;
+    chip.load_memory(create_program());
+    Chip8Debugger<Chip8Type> debugger(chip);
+    debugger.add_breakpoint(0x204);
+    auto event = debugger.run(2);
+    EXPECT_EQ(event.reason, DebugStopReason::CycleLimit);
+    EXPECT_EQ(chip.get_program_counter(), 0x20A);
+    // 0x20A..0x210 and the return reach 0x204 after 4 more cycles
+    event = debugger.run(10);
+    EXPECT_EQ(event.reason, DebugStopReason::Breakpoint);
+    EXPECT_EQ(event.address, 0x204);
+    EXPECT_EQ(event.cycles, 4);
+    // Reached exactly on the last cycle of a call, the next call reports it without executing
+    Chip8Type other;
+    other.load_memory(create_program());
+    Chip8Debugger<Chip8Type> other_debugger(other);
+    other_debugger.add_breakpoint(0x204);
+    event = other_debugger.run(6);
+    EXPECT_EQ(event.reason, DebugStopReason::CycleLimit);
+    EXPECT_EQ(other.get_program_counter(), 0x204);
+    event = other_debugger.run(10);
+    EXPECT_EQ(event.reason, DebugStopReason::Breakpoint);
+    EXPECT_EQ(event.cycles, 0);
+    // Resuming steps over it
+    event = other_debugger.run(1);
+    EXPECT_EQ(event.reason, DebugStopReason::CycleLimit);
+    EXPECT_EQ(other.get_program_counter(), 0x206);
+}
+
+TEST(TestChip8Debugger, StopsAfterWatchedMemoryWrite) {
+    Chip8Type chip;
+    chip.load_memory(create_program());
+    Chip8Debugger<Chip8Type> debugger(chip);
+    debugger.add_memory_watchpoint(0x301, 0x302, false, true);
+    EXPECT_TRUE(debugger.is_instrumented());
+    const auto event = debugger.run(100);
+    EXPECT_EQ(event.reason, DebugStopReason::MemoryWrite);
+    EXPECT_EQ(event.address, 0x301);
+    EXPECT_EQ(event.cycles, 4);
+    debugger.clear();
+    EXPECT_FALSE(debugger.is_instrumented());
+}
+
+TEST(TestChip8Debugger, IgnoresWritesOnReadWatchpoint) {
+    Chip8Type chip;
+    chip.load_memory(create_program());
+    Chip8Debugger<Chip8Type> debugger(chip);
+    debugger.add_memory_watchpoint(0x300, 0x310, true, false);
+    const auto event = debugger.run(100);
+    EXPECT_EQ(event.reason, DebugStopReason::CycleLimit);
+    EXPECT_EQ(event.cycles, 100);
+}
+
+TEST(TestChip8Debugger, StopsOnRegisterCondition) {
+    Chip8Type chip;
+    chip.load_memory(create_program());
+    Chip8Debugger<Chip8Type> debugger(chip);
+    debugger.add_register_watchpoint(2, [](unsigned char, unsigned char new_value) { return new_value == 0x33; });
+    const auto event = debugger.run(100);
+    EXPECT_EQ(event.reason, DebugStopReason::RegisterChange);
+    EXPECT_EQ(event.register_index, 2);
+    EXPECT_EQ(event.cycles, 7);
+}
+
+TEST(TestChip8Debugger, RejectsRegisterWatchpointOutOfRange) {
+    Chip8Type chip;
+    chip.load_memory(create_program());
+    Chip8Debugger<Chip8Type> debugger(chip);
+    EXPECT_FALSE(debugger.add_register_watchpoint(16));
+    EXPECT_FALSE(debugger.add_register_watchpoint(-1));
+    EXPECT_FALSE(debugger.is_instrumented());
+    EXPECT_TRUE(debugger.add_register_watchpoint(15));
+    EXPECT_TRUE(debugger.is_instrumented());
+}
+
+TEST(TestChip8Debugger, StepOverSubroutineCall) {
+    Chip8Type chip;
+    chip.load_memory(create_program());
+    Chip8Debugger<Chip8Type> debugger(chip);
+    auto event = debugger.step();
+    EXPECT_EQ(event.reason, DebugStopReason::Step);
+    EXPECT_EQ(event.cycles, 1);
+    event = debugger.step_over(100);
+    EXPECT_EQ(event.reason, DebugStopReason::Step);
+    EXPECT_EQ(event.cycles, 5);
+    // Stepping into the call stops at its first instruction
+    Chip8Type other;
+    other.load_memory(create_program());
+    Chip8Debugger<Chip8Type> other_debugger(other);
+    other_debugger.step();
+    other_debugger.step();
+    EXPECT_EQ(other.get_program_counter(), 0x20A);
+    other_debugger.add_breakpoint(0x204);
+    event = other_debugger.run(100);
+    EXPECT_EQ(event.reason, DebugStopReason::Breakpoint);
+    EXPECT_EQ(event.cycles, 4);
+}
+
+TEST(TestChip8Debugger, StopsOnTrap) {
+    Chip8Type chip;
+    Program memory{};
+    set_opcode_to_memory_index(0x6011, memory, 0);
+    set_opcode_to_memory_index(0xF0FF, memory, 2);
+    chip.load_memory(memory);
+    Chip8Debugger<Chip8Type> debugger(chip);
+    debugger.add_breakpoint(0x300);
+    const auto event = debugger.run(100);
+    EXPECT_EQ(event.reason, DebugStopReason::Trap);
+    EXPECT_EQ(event.trap, Trap::InvalidOpcode);
+    EXPECT_EQ(event.cycles, 1);
+}
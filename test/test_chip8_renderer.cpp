@@ -0,0 +1,102 @@
+//
+// Created by andreas on 18.10.26.
+//
+#include <sstream>
+#include "gtest/gtest.h"
+#include "./../chip8/chip8_renderer.h"
+
+// Replays the terminal output of a renderer into a grid of half block cells, 0x1 for the upper and 0x2 for the
+// lower pixel. Only the sequences written by TerminalRenderer are understood.
+template<size_t width, size_t rows>
+std::array<uint8_t, width * rows> replay(const std::string &output) {
+    static const std::string blocks[]{" ", "▀", "▄", "█"};
+    std::array<uint8_t, width * rows> cells{};
+    size_t row{};
+    size_t column{};
+    for (size_t i{}; i < output.size();) {
+        if (output.compare(i, 4, "\x1b[2J") == 0) {
+            cells.fill(0);
+            i += 4;
+        } else if (output[i] == '\x1b') {
+            const size_t separator = output.find(';', i);
+            const size_t end = output.find('H', i);
+            row = std::stoul(output.substr(i + 2, separator - i - 2)) - 1;
+            column = std::stoul(output.substr(separator + 1, end - separator - 1)) - 1;
+            i = end + 1;
+        } else {
+            uint8_t cell{};
+            while (output.compare(i, blocks[cell].size(), blocks[cell]) != 0) {
+                ++cell;
+                if (cell == 4)
+                    return {};
+            }
+            cells.at(column++ + row * width) = cell;
+            i += blocks[cell].size();
+        }
+    }
+    return cells;
+}
+
+TEST(TestChip8Renderer, TripleBufferKeepsNewestFrame) {
+    TripleBuffer<int> buffer;
+    EXPECT_FALSE(buffer.consume());
+    buffer.back() = 1;
+    buffer.publish();
+    buffer.back() = 2;
+    buffer.publish();
+    EXPECT_TRUE(buffer.consume());
+    EXPECT_EQ(buffer.front(), 2);
+    EXPECT_FALSE(buffer.consume());
+    EXPECT_EQ(buffer.front(), 2);
+    buffer.back() = 3;
+    buffer.publish();
+    EXPECT_TRUE(buffer.consume());
+    EXPECT_EQ(buffer.front(), 3);
+}
+
+TEST(TestChip8Renderer, DrawsOnlyChangedCells) {
+    using Renderer = TerminalRenderer<4, 4>;
+    Renderer::Framebuffer graphics{};
+    std::array<uint8_t, 4 * Renderer::number_of_rows> cells{};
+    std::string output;
+    EXPECT_EQ(Renderer::draw_changes(graphics, cells, output), 0);
+    EXPECT_TRUE(output.empty());
+
+    // Upper pixel of cell (0, 1), both pixels of cell (1, 2) and cell (1, 3)
+    graphics[1] = 1;
+    graphics[2 + 2 * 4] = 1;
+    graphics[2 + 3 * 4] = 1;
+    graphics[3 + 2 * 4] = 1;
+    graphics[3 + 3 * 4] = 1;
+    EXPECT_EQ(Renderer::draw_changes(graphics, cells, output), 3);
+    EXPECT_EQ(output, "\x1b[1;2H▀\x1b[2;3H██");
+
+    output.clear();
+    graphics[3 + 2 * 4] = 0;
+    EXPECT_EQ(Renderer::draw_changes(graphics, cells, output), 1);
+    EXPECT_EQ(output, "\x1b[2;4H▄");
+}
+
+TEST(TestChip8Renderer, RendererDrawsLastPublishedFrame) {
+    using Renderer = TerminalRenderer<4, 2>;
+    std::ostringstream out;
+    Renderer renderer(out);
+    Renderer::Framebuffer graphics{};
+    for (size_t frame{}; frame < 100; ++frame) {
+        graphics[frame % 8] ^= 1;
+        renderer.publish(graphics);
+    }
+    renderer.stop();
+    EXPECT_EQ(renderer.published_frames(), 100);
+    EXPECT_GE(renderer.drawn_frames(), 1);
+    EXPECT_LE(renderer.drawn_frames(), 100);
+
+    const std::string output = out.str();
+    EXPECT_EQ(output.rfind("\x1b[2J", 0), 0);
+    // Pixels 0 to 3 are toggled 13 times and end up set, 4 to 7 12 times
+    std::array<uint8_t, 4 * Renderer::number_of_rows> expected{};
+    std::string expected_output;
+    Renderer::draw_changes(graphics, expected, expected_output);
+    EXPECT_EQ(expected, (std::array<uint8_t, 4>{0x1, 0x1, 0x1, 0x1}));
+    EXPECT_EQ((replay<4, Renderer::number_of_rows>(output)), expected);
+}
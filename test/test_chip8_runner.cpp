@@ -0,0 +1,100 @@
+//
+// Created by andreas on 18.10.26.
+//
+#include <cstdio>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "./../chip8/chip8.h"
+#include "./../chip8/chip8_runner.h"
+
+using Chip8Type = Chip8<4096, 16, 64, 32, 16, 16>;
+
+// V0 = 5; I = sprite of V0; V1 = 2; draw at (V1, V1); wait for key in V4; jump to itself
+const std::vector<unsigned char> program{0x60, 0x05, 0xF0, 0x29, 0x61, 0x02, 0xD1, 0x15, 0xF4, 0x0A, 0x12, 0x0A};
+
+TEST(TestChip8Runner, StopsOnHalt) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    RunOptions options;
+    const auto result = run_frames(chip, options, {{3, 0xB, true}});
+    EXPECT_EQ(result.stop, RunStop::Halt);
+    EXPECT_EQ(result.frames, 4);
+    EXPECT_EQ(chip.get_program_counter(), 0x20A);
+    EXPECT_EQ(chip.get_registers()[4], 0xB);
+    EXPECT_GT(result.skipped_cycles, 0);
+}
+
+TEST(TestChip8Runner, StopsAtProgramCounter) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    RunOptions options;
+    options.stop_at_program_counter = true;
+    options.stop_program_counter = 0x206;
+    const auto result = run_frames(chip, options);
+    EXPECT_EQ(result.stop, RunStop::ProgramCounter);
+    EXPECT_EQ(result.cycles, 3);
+    EXPECT_EQ(chip.get_program_counter(), 0x206);
+}
+
+TEST(TestChip8Runner, StopsAtProgramCounterOnFrameBoundary) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    RunOptions options;
+    options.max_frames = 100;
+    options.cycles_per_frame = 3;
+    options.stop_at_program_counter = true;
+    options.stop_program_counter = 0x206;
+    const auto result = run_frames(chip, options);
+    EXPECT_EQ(result.stop, RunStop::ProgramCounter);
+    EXPECT_EQ(result.cycles, 3);
+    EXPECT_EQ(result.frames, 1);
+    EXPECT_EQ(chip.get_program_counter(), 0x206);
+}
+
+TEST(TestChip8Runner, StopsAtFrameLimitWithoutKeys) {
+    Chip8Type chip;
+    chip.load_memory(program);
+    RunOptions options;
+    options.max_frames = 1000;
+    const auto result = run_frames(chip, options);
+    EXPECT_EQ(result.stop, RunStop::FrameLimit);
+    EXPECT_EQ(result.cycles, 1000 * options.cycles_per_frame);
+    EXPECT_EQ(chip.get_program_counter(), 0x208);
+    // The digit 5 is drawn at (2, 2)
+    EXPECT_EQ(chip.get_graphics()[2 + 2 * 64], 1);
+}
+
+TEST(TestChip8Runner, KeyWaitFramesMatchFrameByFrame) {
+    Chip8Type skipped;
+    skipped.load_memory(program);
+    Chip8Type stepped;
+    stepped.load_memory(program);
+    RunOptions options;
+    options.max_frames = 500;
+    const std::vector<KeyEvent> key_trace{{200, 0x3, true}, {201, 0x3, false}};
+    const auto skipped_result = run_frames(skipped, options, key_trace);
+    size_t frames{};
+    options.on_frame = [&]() { ++frames; };
+    const auto stepped_result = run_frames(stepped, options, key_trace);
+    EXPECT_EQ(skipped_result.stop, RunStop::Halt);
+    EXPECT_EQ(skipped_result.stop, stepped_result.stop);
+    EXPECT_EQ(skipped_result.frames, 201);
+    EXPECT_EQ(skipped_result.frames, stepped_result.frames);
+    EXPECT_EQ(frames, stepped_result.frames);
+    EXPECT_EQ(skipped_result.cycles, stepped_result.cycles);
+    EXPECT_EQ(skipped.get_registers(), stepped.get_registers());
+    EXPECT_EQ(skipped.get_program_counter(), stepped.get_program_counter());
+    EXPECT_EQ(skipped.get_registers()[4], 0x3);
+}
+
+TEST(TestChip8Runner, KeyTraceWithKeyOutOfRangeIsRejected) {
+    const std::string filename = testing::TempDir() + "chip8_key_trace.txt";
+    std::ofstream(filename) << "0 15 1\n0 200 1\n";
+    std::vector<KeyEvent> key_trace;
+    EXPECT_FALSE(load_key_trace(filename, key_trace));
+    std::ofstream(filename) << "0 15 1\n3 15 0\n";
+    key_trace.clear();
+    EXPECT_TRUE(load_key_trace(filename, key_trace));
+    EXPECT_EQ(key_trace.size(), 2);
+    std::remove(filename.c_str());
+}